@@ -48,6 +48,7 @@
 #endif	/* HAVE_OCTAVE_MEX_H */
 /* our stuff */
 #include "tzraw.h"
+#include "nifty.h"
 
 /* see tzconv.m for details */
 
@@ -88,25 +89,37 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 #define TO_UNIX(x)	((x) - 719529.0) * 86400.0
 #define TO_MATL(x)	((x) / 86400.0) + 719529.0
 	{
-		mwSize m = mxGetM(prhs[0]);
-		mwSize n = mxGetN(prhs[0]);
+		const size_t m = mxGetM(prhs[0]) * mxGetN(prhs[0]);
 		const double *src = mxGetPr(prhs[0]);
 		double *tgt;
+		/* convert in chunks, fractions of seconds are kept aside */
+		stamp_t buf[4096U];
+		double frac[countof(buf)];
 
-		plhs[0] = mxCreateDoubleMatrix(m, n, mxREAL);
+		plhs[0] = mxCreateDoubleMatrix(
+			mxGetM(prhs[0]), mxGetN(prhs[0]), mxREAL);
 		tgt = mxGetPr(plhs[0]);
 
-		for (mwSize i = 0; i < m * n; i++) {
-			double x = TO_UNIX(src[i]);
+		for (size_t i = 0U; i < m; i += countof(buf)) {
+			const size_t k = m - i < countof(buf) ? m - i : countof(buf);
 
-			if (x < 2147483647.0 && x > -2147483648.0) {
-				double frac = modf(x, &x);
-				int32_t utc = zif_utc_time(fromz, (int32_t)x);
-				int32_t lcl = zif_local_time(toz, utc);
+			for (size_t j = 0U; j < k; j++) {
+				double x = TO_UNIX(src[i + j]);
 
-				tgt[i] = TO_MATL((double)lcl) + frac / 86400.0;
-			} else {
-				tgt[i] = NAN;
+				if (x < (double)STAMP_MAX && x > (double)STAMP_MIN) {
+					frac[j] = modf(x, &x);
+					buf[j] = (stamp_t)x;
+				} else {
+					/* NaNs end up here too */
+					frac[j] = NAN;
+					/* keep the sweeps going */
+					buf[j] = j ? buf[j - 1U] : 0;
+				}
+			}
+			zif_utc_time_v(fromz, buf, buf, k);
+			zif_local_time_v(toz, buf, buf, k);
+			for (size_t j = 0U; j < k; j++) {
+				tgt[i + j] = TO_MATL((double)buf[j]) + frac[j] / 86400.0;
 			}
 		}
 	}
@@ -116,4 +129,4 @@ mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
 	return;
 }
 
-/* gand_get_series.c ends here */
+/* tzconv.c ends here */
@@ -146,6 +146,130 @@ __fixup_zdiff(struct dt_dt_s dt, int32_t zdiff)
 	return dt;
 }
 
+#if BYTE_ORDER == LITTLE_ENDIAN
+/* SWAR fast path for the fixed-width ISO 8601 shapes YYYY-MM-DD and
+ * HH:MM:SS, one 64bit load, one digit/separator check for all 8 bytes,
+ * one multiply-add to turn digit pairs into numbers
+ * strings shorter than 8 bytes and anything slightly off go down the
+ * slow (but general) route */
+# define SWAR_ONES	(0x0101010101010101ULL)
+
+static inline __attribute__((pure)) bool
+__swar_loadable_p(const char *str)
+{
+/* whether 8 bytes at STR can be loaded, i.e. none of them is the \0
+ * terminator, strnlen() never looks beyond it */
+	return strnlen(str, sizeof(uint64_t)) >= sizeof(uint64_t);
+}
+
+static inline __attribute__((pure)) uint64_t
+__swar_ld(const char *str)
+{
+	uint64_t w;
+	memcpy(&w, str, sizeof(w));
+	return w;
+}
+
+static inline __attribute__((const)) uint64_t
+__swar_chk(uint64_t w, uint64_t tmpl, uint64_t dmsk, uint64_t smsk)
+{
+/* XOR W with template TMPL, bytes under DMSK must come out <= 9,
+ * bytes under SMSK must come out 0, return non-0 if either fails */
+	const uint64_t x = (w ^ tmpl) & (dmsk | smsk);
+	return (((x + 0x76U * SWAR_ONES) | x) & 0x80U * SWAR_ONES) | (x & smsk);
+}
+
+static inline __attribute__((const)) uint64_t
+__swar_pairs(uint64_t w, uint64_t tmpl, uint64_t dmsk)
+{
+/* byte i of the result is 10 * digit i + digit i+1 */
+	const uint64_t x = (w ^ tmpl) & dmsk;
+	return x * 10U + (x >> 8U);
+}
+
+static inline __attribute__((const)) unsigned int
+__swar_byte(uint64_t p, unsigned int i)
+{
+	return (p >> (i * 8U)) & 0xffU;
+}
+
+static bool
+__strpd_iso(struct dt_d_s *tgt, const char *str)
+{
+/* YYYY-MM-DD followed by something that isn't a digit, ymcw or bizda */
+	static const uint64_t tmpl = 0x2d30302d30303030ULL;/* 0000-00- */
+	static const uint64_t dmsk = 0x00ffff00ffffffffULL;
+	static const uint64_t smsk = 0xff0000ff00000000ULL;
+	struct strpd_s d = {0};
+	uint64_t w;
+
+	if (UNLIKELY(!__swar_loadable_p(str))) {
+		return false;
+	} else if (__swar_chk(w = __swar_ld(str), tmpl, dmsk, smsk)) {
+		return false;
+	}
+	/* all 8 bytes are non-NUL, so bytes 8 to 10 are addressable */
+	if ((unsigned char)(str[8U] - '0') > 9U ||
+	    (unsigned char)(str[9U] - '0') > 9U) {
+		return false;
+	}
+	switch (str[10U]) {
+	case '0' ... '9':
+	case '-':
+	case 'B':
+	case 'b':
+		return false;
+	default:
+		break;
+	}
+	with (uint64_t p = __swar_pairs(w, tmpl, dmsk)) {
+		d.y = __swar_byte(p, 0U) * 100 + __swar_byte(p, 2U);
+		d.m = __swar_byte(p, 5U);
+	}
+	d.d = (str[8U] - '0') * 10 + (str[9U] - '0');
+	if (d.y < DT_MIN_YEAR || d.y > DT_MAX_YEAR || d.d > 31) {
+		return false;
+	}
+	d.c = -1;
+	*tgt = __guess_dtyp(d);
+	return true;
+}
+
+static bool
+__strpt_iso(struct strpt_s *tgt, const char *str)
+{
+/* HH:MM:SS followed by something that isn't a digit */
+	static const uint64_t tmpl = 0x30303a30303a3030ULL;/* 00:00:00 */
+	static const uint64_t dmsk = 0xffff00ffff00ffffULL;
+	static const uint64_t smsk = 0x0000ff0000ff0000ULL;
+	unsigned int h, m, s;
+	uint64_t w;
+
+	if (UNLIKELY(!__swar_loadable_p(str))) {
+		return false;
+	} else if (__swar_chk(w = __swar_ld(str), tmpl, dmsk, smsk)) {
+		return false;
+	} else if ((unsigned char)(str[8U] - '0') <= 9U) {
+		return false;
+	}
+	with (uint64_t p = __swar_pairs(w, tmpl, dmsk)) {
+		h = __swar_byte(p, 0U);
+		m = __swar_byte(p, 3U);
+		s = __swar_byte(p, 6U);
+	}
+	if (h > 24U || m > 59U || s > 60U) {
+		return false;
+	}
+	tgt->h = h;
+	tgt->m = m;
+	tgt->s = s;
+	return true;
+}
+#else  /* !LITTLE_ENDIAN */
+# define __strpd_iso(x, y)	(false)
+# define __strpt_iso(x, y)	(false)
+#endif	/* LITTLE_ENDIAN */
+
 DEFUN struct dt_dt_s
 __strpdt_std(const char *str, char **ep)
 {
@@ -171,7 +295,10 @@ __strpdt_std(const char *str, char **ep)
 		}
 		goto out;
 	}
-	with (char *tmp) {
+	if (__strpd_iso(&res.d, str)) {
+		/* fast path, all 10 bytes consumed */
+		sp = str + 10U;
+	} else with (char *tmp) {
 		/* let date-core do the hard yakka */
 		if ((res.d = __strpd_std(str, &tmp)).typ == DT_DUNK) {
 			/* not much use parsing on */
@@ -195,7 +322,15 @@ __strpdt_std(const char *str, char **ep)
 	}
 try_time:
 	/* and now parse the time */
-	if ((d.st.h = strtoi_lim(sp, &sp, 0, 24)) < 0 ||
+	if (__strpt_iso(&d.st, sp)) {
+		/* fast path, only the fractional part is left to do */
+		sp += 8U;
+		if (*sp == '.' &&
+		    (sp++, d.st.ns = strtoi_lim(sp, &sp, 0, 999999999)) < 0) {
+			d.st.ns = 0;
+		}
+		goto eval_time;
+	} else if ((d.st.h = strtoi_lim(sp, &sp, 0, 24)) < 0 ||
 	    *sp != ':') {
 		sp = str;
 		goto out;
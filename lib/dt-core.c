@@ -41,6 +41,7 @@
 #if defined HAVE_CONFIG_H
 # include "config.h"
 #endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 #include <stdio.h>
@@ -608,26 +609,68 @@ need_milfup_p(const char *fmt)
 
 
 /* parser implementations */
-DEFUN struct dt_dt_s
-dt_strpdt(const char *str, const char *fmt, char **ep)
-{
-	struct dt_dt_s res = {DT_UNK};
-	struct strpdt_s d = {0};
-	const char *sp = str;
-	const char *fp;
+struct dt_fmtop_s {
+	struct dt_spec_s spec;
+	/* literal to match, for ops with spec.spfl == DT_SPFL_UNK */
+	char lit;
+};
 
-	if (LIKELY(fmt == NULL)) {
-		return __strpdt_std(str, ep);
+struct dt_fmtprog_s {
+	/* calendar type for named formats, so we can catch jdn/ldn/mdn */
+	dt_dttyp_t typ;
+	/* input only, the standard format */
+	unsigned int stdp:1U;
+	/* output only, leave everything to dt_strfdt() */
+	unsigned int fbp:1U;
+	/* output only, military midnights decay */
+	unsigned int milfupp:1U;
+	/* output only, programs for the calendars' default formats */
+	dt_fmtprog_t *dflt;
+	/* output only, the original format */
+	const char *fmt;
+	size_t nop;
+	struct dt_fmtop_s op[];
+};
+
+/* indices into the default output programs */
+enum {
+	STRF_YMDHMS,
+	STRF_YMCWHMS,
+	STRF_YWDHMS,
+	STRF_YDHMS,
+	STRF_BIZDAHMS,
+	STRF_YMD,
+	STRF_YMCW,
+	STRF_YWD,
+	STRF_YD,
+	STRF_BIZDA,
+	NSTRF_DFLT,
+};
+
+static inline struct dt_fmtop_s
+__tok_op(const char *fp, const char **ep)
+{
+	struct dt_fmtop_s res = {
+		.spec = __tok_spec(fp, ep),
+		.lit = *fp,
+	};
+
+	if (UNLIKELY(*fp == '%' && !fp[1U])) {
+		/* lone % at the end, don't run past the \0 */
+		*ep = fp + 1U;
 	}
-	/* translate high-level format names, for sandwiches */
-	switch ((dt_dtyp_t)__trans_dtfmt(&fmt)) {
-		char *on;
-	default:
-		break;
+	return res;
+}
 
-		/* special case julian/lilian dates as they have
-		 * no format specifiers */
+static struct dt_dt_s
+__strpdt_xdn(dt_dttyp_t typ, const char *str, const char **ep)
+{
+/* julian/lilian/matlab dates have no format specifiers */
+	struct dt_dt_s res = {DT_UNK};
+	const char *sp = str;
+	char *on;
 
+	switch ((dt_dtyp_t)typ) {
 	case DT_JDN:
 		/* we demand a float representation from start to finish */
 		res.d.jdn = (dt_jdn_t)strtod(str, &on);
@@ -640,7 +683,7 @@ dt_strpdt(const char *str, const char *fmt, char **ep)
 		sp = on;
 		/* don't worry about time slot or date/time sandwiches */
 		dt_make_d_only(&res, DT_JDN);
-		goto sober;
+		break;
 
 	case DT_LDN:
 		res.d.ldn = (dt_ldn_t)strtoi32(str, &sp);
@@ -666,7 +709,7 @@ dt_strpdt(const char *str, const char *fmt, char **ep)
 			/* looking good */
 			dt_make_d_only(&res, DT_LDN);
 		}
-		goto sober;
+		break;
 
 	case DT_MDN:
 		res.d.mdn = (dt_ldn_t)strtoi32(str, &sp);
@@ -692,52 +735,67 @@ dt_strpdt(const char *str, const char *fmt, char **ep)
 			/* looking good */
 			dt_make_d_only(&res, DT_MDN);
 		}
-		goto sober;
+		break;
+
+	default:
+		goto fucked;
 	}
+	*ep = sp;
+	return res;
+fucked:
+	*ep = str;
+	return (struct dt_dt_s){DT_UNK};
+}
 
-	fp = fmt;
-	while (*fp && *sp) {
-		const char *fp_sav = fp;
-		struct dt_spec_s spec = __tok_spec(fp_sav, &fp);
+static inline int
+__strpdt_op(struct strpdt_s *d, struct dt_fmtop_s op, const char **ep)
+{
+/* execute a single op on *EP, advance *EP */
+	const char *sp = *ep;
 
-		if (spec.spfl == DT_SPFL_UNK) {
-			/* must be literal */
-			if (UNLIKELY(*fp_sav != *sp++)) {
-				goto fucked;
-			}
-		} else if (LIKELY(!spec.rom)) {
-			const char *sp_sav = sp;
-			if (__strpdt_card(&d, sp, spec, (char**)&sp) < 0) {
-				goto fucked;
-			}
-			if (spec.ord &&
-			    __ordinalp(sp_sav, sp - sp_sav, (char**)&sp) < 0) {
-				;
-			}
-			if (spec.bizda) {
-				switch (*sp++) {
-				case 'B':
-					d.sd.flags.ab = BIZDA_BEFORE;
-				case 'b':
-					d.sd.flags.bizda = 1;
-					break;
-				default:
-					/* it's a bizda anyway */
-					d.sd.flags.bizda = 1;
-					sp--;
-					break;
-				}
-			}
-		} else if (UNLIKELY(spec.rom)) {
-			if (__strpd_rom(&d.sd, sp, spec, (char**)&sp) < 0) {
-				goto fucked;
+	if (op.spec.spfl == DT_SPFL_UNK) {
+		/* must be literal */
+		if (UNLIKELY(op.lit != *sp++)) {
+			return -1;
+		}
+	} else if (LIKELY(!op.spec.rom)) {
+		const char *sp_sav = sp;
+		if (__strpdt_card(d, sp, op.spec, (char**)&sp) < 0) {
+			return -1;
+		}
+		if (op.spec.ord &&
+		    __ordinalp(sp_sav, sp - sp_sav, (char**)&sp) < 0) {
+			;
+		}
+		if (op.spec.bizda) {
+			switch (*sp++) {
+			case 'B':
+				d->sd.flags.ab = BIZDA_BEFORE;
+			case 'b':
+				d->sd.flags.bizda = 1;
+				break;
+			default:
+				/* it's a bizda anyway */
+				d->sd.flags.bizda = 1;
+				sp--;
+				break;
 			}
 		}
+	} else if (UNLIKELY(op.spec.rom)) {
+		if (__strpd_rom(&d->sd, sp, op.spec, (char**)&sp) < 0) {
+			return -1;
+		}
 	}
-	/* check suffix literal */
-	if (*fp && *fp != *sp) {
-		goto fucked;
-	}
+	*ep = sp;
+	return 0;
+}
+
+static struct dt_dt_s
+__strpdt_fin(struct strpdt_s d)
+{
+/* turn the parsed fields in D into a dt_dt_s */
+	struct dt_dt_s res = {DT_UNK};
+
 	/* check if it's a sexy type */
 	if (d.i) {
 		res.typ = DT_SEXY;
@@ -763,6 +821,48 @@ dt_strpdt(const char *str, const char *fmt, char **ep)
 	} else if (d.zngvn && dt_sandwich_p(res)) {
 		res.znfxd = 1;
 	}
+	return res;
+}
+
+DEFUN struct dt_dt_s
+dt_strpdt(const char *str, const char *fmt, char **ep)
+{
+	struct dt_dt_s res = {DT_UNK};
+	struct strpdt_s d = {0};
+	const char *sp = str;
+	const char *fp;
+	dt_dttyp_t typ;
+
+	if (LIKELY(fmt == NULL)) {
+		return __strpdt_std(str, ep);
+	}
+	/* translate high-level format names, for sandwiches */
+	switch ((dt_dtyp_t)(typ = __trans_dtfmt(&fmt))) {
+	default:
+		break;
+
+		/* special case julian/lilian dates as they have
+		 * no format specifiers */
+	case DT_JDN:
+	case DT_LDN:
+	case DT_MDN:
+		res = __strpdt_xdn(typ, str, &sp);
+		goto sober;
+	}
+
+	fp = fmt;
+	while (*fp && *sp) {
+		const struct dt_fmtop_s op = __tok_op(fp, &fp);
+
+		if (__strpdt_op(&d, op, &sp) < 0) {
+			goto fucked;
+		}
+	}
+	/* check suffix literal */
+	if (*fp && *fp != *sp) {
+		goto fucked;
+	}
+	res = __strpdt_fin(d);
 
 sober:
 	/* set the end pointer */
@@ -777,6 +877,407 @@ fucked:
 	return (struct dt_dt_s){DT_UNK};
 }
 
+/* the program for the standard format, shared by everyone */
+static struct dt_fmtprog_s strpdt_std_prog = {.stdp = 1U};
+
+DEFUN dt_fmtprog_t
+dt_strpdt_compile(const char *fmt)
+{
+	struct dt_fmtprog_s *res;
+	dt_dttyp_t typ;
+	size_t nop = 0U;
+
+	if (fmt == NULL) {
+		return &strpdt_std_prog;
+	}
+	/* translate high-level format names, for sandwiches */
+	typ = __trans_dtfmt(&fmt);
+	/* there's at most one op per format character */
+	res = malloc(sizeof(*res) + strlen(fmt) * sizeof(*res->op));
+	if (UNLIKELY(res == NULL)) {
+		return NULL;
+	}
+	for (const char *fp = fmt; *fp; nop++) {
+		res->op[nop] = __tok_op(fp, &fp);
+	}
+	res->typ = typ;
+	res->nop = nop;
+	return res;
+}
+
+DEFUN void
+dt_strpdt_free(dt_fmtprog_t prog)
+{
+	if (prog == &strpdt_std_prog) {
+		/* not ours to free */
+		return;
+	}
+	free(prog);
+	return;
+}
+
+DEFUN struct dt_dt_s
+dt_strpdt_prog(dt_fmtprog_t prog, const char *str, char **ep)
+{
+	struct dt_dt_s res = {DT_UNK};
+	struct strpdt_s d = {0};
+	const char *sp = str;
+	size_t i;
+
+	if (LIKELY(prog == NULL || prog->stdp)) {
+		return __strpdt_std(str, ep);
+	}
+	switch ((dt_dtyp_t)prog->typ) {
+	default:
+		break;
+
+	case DT_JDN:
+	case DT_LDN:
+	case DT_MDN:
+		res = __strpdt_xdn(prog->typ, str, &sp);
+		goto sober;
+	}
+
+	for (i = 0U; i < prog->nop && *sp; i++) {
+		if (__strpdt_op(&d, prog->op[i], &sp) < 0) {
+			goto fucked;
+		}
+	}
+	/* ops left over but the string's exhausted */
+	if (i < prog->nop) {
+		goto fucked;
+	}
+	res = __strpdt_fin(d);
+
+sober:
+	/* set the end pointer */
+	if (ep != NULL) {
+		*ep = (char*)sp;
+	}
+	return res;
+fucked:
+	if (ep != NULL) {
+		*ep = (char*)str;
+	}
+	return (struct dt_dt_s){DT_UNK};
+}
+
+/* shapes */
+struct __shape_atom_s {
+	/* acceptable bytes */
+	uint64_t set[4U];
+	/* width range */
+	unsigned int wmin;
+	unsigned int wmax;
+};
+
+static inline void
+__shape_rng(uint64_t set[static 4U], unsigned char lo, unsigned char hi)
+{
+	for (unsigned int c = lo; c <= hi; c++) {
+		set[c / 64U] |= 1ULL << (c % 64U);
+	}
+	return;
+}
+
+static inline unsigned int
+__shape_ndig(int32_t ulim)
+{
+/* number of digits strtoi_lim() reads at most given ULIM */
+	unsigned int n = 0U;
+	for (int32_t rulim = ulim > 10 ? ulim : 10; rulim; rulim /= 10, n++);
+	return n;
+}
+
+static size_t
+__shape_atoms(struct __shape_atom_s *restrict tgt, struct dt_fmtop_s op)
+{
+/* translate OP into at most 5 atoms, return the number of atoms
+ * or 0 if OP is beyond our means */
+	struct dt_spec_s s = op.spec;
+	size_t n = 0U;
+
+#define NUM(ulim)							\
+	(tgt[n] = (struct __shape_atom_s){.wmin = 1U, .wmax = __shape_ndig(ulim)}, \
+	 __shape_rng(tgt[n].set, '0', '9'), n++)
+#define LIT(c)								\
+	(tgt[n] = (struct __shape_atom_s){.wmin = 1U, .wmax = 1U},	\
+	 __shape_rng(tgt[n].set, c, c), n++)
+#define ANY()								\
+	(tgt[n] = (struct __shape_atom_s){.wmin = 1U, .wmax = 1U},	\
+	 __shape_rng(tgt[n].set, 0U, 255U), n++)
+
+	if (s.ord || s.rom || s.bizda) {
+		/* suffixes and roman numerals, too much hassle */
+		return 0U;
+	}
+	switch (s.spfl) {
+	case DT_SPFL_UNK:
+		LIT(op.lit);
+		break;
+	case DT_SPFL_N_DSTD:
+		/* separators are skipped over blindly */
+		NUM(DT_MAX_YEAR);
+		ANY();
+		NUM(GREG_MONTHS_P_YEAR);
+		ANY();
+		NUM(31);
+		break;
+	case DT_SPFL_N_YEAR:
+		switch (s.abbr) {
+		case DT_SPMOD_LONG:
+			NUM(DT_MAX_YEAR);
+			break;
+		case DT_SPMOD_NORM:
+			NUM(99);
+			break;
+		case DT_SPMOD_ABBR:
+			NUM(9);
+			tgt[0U].wmax = 1U;
+			break;
+		default:
+			return 0U;
+		}
+		break;
+	case DT_SPFL_N_MON:
+		NUM(GREG_MONTHS_P_YEAR);
+		break;
+	case DT_SPFL_N_DCNT_MON:
+		/* padstrtoi_lim() allows for leading blanks */
+		NUM(31);
+		__shape_rng(tgt[0U].set, ' ', ' ');
+		break;
+	case DT_SPFL_N_DCNT_WEEK:
+		NUM(GREG_DAYS_P_WEEK);
+		break;
+	case DT_SPFL_N_WCNT_MON:
+		NUM(5);
+		break;
+	case DT_SPFL_N_TSTD:
+		NUM(23);
+		LIT(':');
+		NUM(59);
+		LIT(':');
+		NUM(60);
+		break;
+	case DT_SPFL_N_HOUR:
+		NUM(23);
+		break;
+	case DT_SPFL_N_MIN:
+		NUM(59);
+		break;
+	case DT_SPFL_N_SEC:
+		NUM(60);
+		break;
+	case DT_SPFL_N_NANO:
+		NUM(999999999);
+		break;
+	case DT_SPFL_S_AMPM:
+		LIT('a');
+		__shape_rng(tgt[0U].set, 'A', 'A');
+		__shape_rng(tgt[0U].set, 'P', 'P');
+		__shape_rng(tgt[0U].set, 'p', 'p');
+		LIT('m');
+		__shape_rng(tgt[1U].set, 'M', 'M');
+		break;
+	case DT_SPFL_LIT_PERCENT:
+		LIT('%');
+		break;
+	case DT_SPFL_LIT_TAB:
+		LIT('\t');
+		break;
+	case DT_SPFL_LIT_NL:
+		LIT('\n');
+		break;
+	default:
+		/* names (locale-dependent), zones, epochs, etc. */
+		return 0U;
+	}
+#undef NUM
+#undef LIT
+#undef ANY
+	return n;
+}
+
+DEFUN void
+dt_strpdt_shape(struct dt_shape_s *tgt, dt_fmtprog_t prog)
+{
+/* we track the set of offsets an op can start at, every op then
+ * contributes its bytes to the positions it can possibly cover */
+	unsigned int reach = 1U;
+
+	memset(tgt, 0, sizeof(*tgt));
+	if (prog == NULL || prog->stdp) {
+		/* standard format, digits or epoch */
+		__shape_rng(tgt->set[0U], '0', '9');
+		__shape_rng(tgt->set[0U], '@', '@');
+		tgt->len = 1U;
+		return;
+	}
+	switch ((dt_dtyp_t)prog->typ) {
+	case DT_JDN:
+	case DT_LDN:
+	case DT_MDN:
+		/* strtod() territory */
+		tgt->len = 0U;
+		return;
+	default:
+		break;
+	}
+	tgt->len = DT_SHAPE_LEN;
+	for (size_t i = 0U; i < prog->nop && reach; i++) {
+		struct __shape_atom_s a[5U];
+		size_t na;
+
+		if (!(na = __shape_atoms(a, prog->op[i]))) {
+			/* only positions before the earliest start are safe */
+			tgt->len = __builtin_ctz(reach);
+			return;
+		}
+		for (size_t j = 0U; j < na; j++) {
+			unsigned int nu = 0U;
+
+			for (unsigned int o = 0U; o < DT_SHAPE_LEN; o++) {
+				if (!(reach >> o & 1U)) {
+					continue;
+				}
+				for (unsigned int k = 0U;
+				     k < a[j].wmax && o + k < DT_SHAPE_LEN; k++) {
+					for (size_t w = 0U; w < 4U; w++) {
+						tgt->set[o + k][w] |= a[j].set[w];
+					}
+				}
+				for (unsigned int w = a[j].wmin;
+				     w <= a[j].wmax && o + w < DT_SHAPE_LEN; w++) {
+					nu |= 1U << (o + w);
+				}
+			}
+			reach = nu;
+		}
+	}
+	if (reach) {
+		/* parsing can stop this early, anything goes after that */
+		tgt->len = __builtin_ctz(reach);
+	}
+	return;
+}
+
+static int
+__strfdt_prep(struct strpdt_s *d, struct dt_dt_s *that, bool milfupp)
+{
+/* fill D from THAT for printing, return -1 if there's nothing to print */
+	/* fix up before printing */
+	if (LIKELY(dt_sandwich_p(*that) || dt_sandwich_only_d_p(*that))) {
+		that->d = dt_dfixup(that->d);
+	}
+	/* make sure we always snarf the zdiff info */
+	d->zdiff = zdiff_sec(*that);
+
+	if (dt_sandwich_p(*that) && UNLIKELY(that->t.hms.h == 24U)) {
+		/* military midnight fixup */
+		if (milfupp) {
+			*that = dt_milfup(*that);
+		}
+	}
+
+	switch (that->typ) {
+	case DT_YMD:
+	ymd_prep:
+		d->sd.y = that->d.ymd.y;
+		d->sd.m = that->d.ymd.m;
+		d->sd.d = that->d.ymd.d;
+		break;
+	case DT_YMCW:
+		d->sd.y = that->d.ymcw.y;
+		d->sd.m = that->d.ymcw.m;
+		d->sd.c = that->d.ymcw.c;
+		d->sd.w = that->d.ymcw.w;
+		break;
+	case DT_YWD:
+		__prep_strfd_ywd(&d->sd, that->d.ywd);
+		break;
+	case DT_YD:
+		d->sd.y = that->d.yd.y;
+		d->sd.d = that->d.yd.d;
+		d->sd.flags.d_dcnt_p = 1U;
+		break;
+	case DT_JDN:
+		*that = dt_dtconv((dt_dttyp_t)DT_DAISY, *that);
+		goto daisy_prep;
+	case DT_LDN:
+		*that = dt_dtconv((dt_dttyp_t)DT_DAISY, *that);
+		goto daisy_prep;
+	case DT_MDN:
+		*that = dt_dtconv((dt_dttyp_t)DT_DAISY, *that);
+		goto daisy_prep;
+	case DT_DAISY:
+	daisy_prep:
+		__prep_strfd_daisy(&d->sd, that->d.daisy);
+		break;
+
+	case DT_BIZDA:
+		__prep_strfd_bizda(
+			&d->sd, that->d.bizda, __get_bizda_param(that->d));
+		break;
+
+	case DT_SEXY:
+		/* instead of leaving this as SEXY turn it into
+		 * DAISY/HMS sandwich */
+		*that = dt_dtconv((dt_dttyp_t)DT_DAISY, *that);
+		/* prep d.sd */
+		goto daisy_prep;
+	case DT_YMDHMS:
+		/* convert this to a YMD/HMS sandwich */
+		*that = dt_dtconv((dt_dttyp_t)DT_YMD, *that);
+		/* prep d.sd */
+		goto ymd_prep;
+
+	default:
+	case DT_DUNK:
+		if (!dt_sandwich_only_t_p(*that)) {
+			return -1;
+		}
+	}
+
+	if (dt_sandwich_p(*that) || dt_sandwich_only_t_p(*that)) {
+		/* cope with the time part */
+		d->st.h = that->t.hms.h;
+		d->st.m = that->t.hms.m;
+		d->st.s = that->t.hms.s;
+		d->st.ns = that->t.hms.ns;
+	}
+	return 0;
+}
+
+static inline size_t
+__strfdt_op(
+	char *restrict buf, size_t bsz, struct dt_fmtop_s op,
+	struct strpdt_s *d, struct dt_dt_s that)
+{
+/* execute a single op, BSZ must be positive */
+	char *bp = buf;
+
+	if (op.spec.spfl == DT_SPFL_UNK) {
+		/* must be literal then */
+		*bp++ = op.lit;
+	} else if (LIKELY(!op.spec.rom)) {
+		bp += __strfdt_card(bp, bsz, op.spec, d, that);
+		if (op.spec.ord) {
+			bp += __ordtostr(bp, buf + bsz - bp);
+		} else if (op.spec.bizda) {
+			/* don't print the b after an ordinal */
+			if (op.spec.ab == BIZDA_AFTER) {
+				*bp++ = 'b';
+			} else {
+				*bp++ = 'B';
+			}
+		}
+	} else if (UNLIKELY(op.spec.rom)) {
+		bp += __strfd_rom(bp, bsz, op.spec, &d->sd, that.d);
+	}
+	return bp - buf;
+}
+
 DEFUN size_t
 dt_strfdt(char *restrict buf, size_t bsz, const char *fmt, struct dt_dt_s that)
 {
@@ -785,6 +1286,7 @@ dt_strfdt(char *restrict buf, size_t bsz, const char *fmt, struct dt_dt_s that)
 	char *bp;
 	dt_dtyp_t tgttyp;
 	int set_fmt = 0;
+	bool milfupp;
 
 	if (UNLIKELY(buf == NULL || bsz == 0)) {
 		bp = buf;
@@ -877,120 +1379,209 @@ dt_strfdt(char *restrict buf, size_t bsz, const char *fmt, struct dt_dt_s that)
 		__trans_tfmt(&fmt);
 	}
 
-	/* fix up before printing */
-	if (LIKELY(dt_sandwich_p(that) || dt_sandwich_only_d_p(that))) {
-		that.d = dt_dfixup(that.d);
-	}
-	/* make sure we always snarf the zdiff info */
-	d.zdiff = zdiff_sec(that);
-
-	if (dt_sandwich_p(that) && UNLIKELY(that.t.hms.h == 24U)) {
-		/* military midnight fixup
-		 * only when there's %H or %T in the flags, don't decay*/
-		if (need_milfup_p(fmt)) {
-			that = dt_milfup(that);
-		}
+	/* military midnight fixup
+	 * only when there's %H or %T in the flags, don't decay*/
+	milfupp = UNLIKELY(that.t.hms.h == 24U) && need_milfup_p(fmt);
+	if (__strfdt_prep(&d, &that, milfupp) < 0) {
+		bp = buf;
+		goto out;
 	}
 
-	switch (that.typ) {
-	case DT_YMD:
-	ymd_prep:
-		d.sd.y = that.d.ymd.y;
-		d.sd.m = that.d.ymd.m;
-		d.sd.d = that.d.ymd.d;
-		break;
-	case DT_YMCW:
-		d.sd.y = that.d.ymcw.y;
-		d.sd.m = that.d.ymcw.m;
-		d.sd.c = that.d.ymcw.c;
-		d.sd.w = that.d.ymcw.w;
-		break;
-	case DT_YWD:
-		__prep_strfd_ywd(&d.sd, that.d.ywd);
-		break;
-	case DT_YD:
-		d.sd.y = that.d.yd.y;
-		d.sd.d = that.d.yd.d;
-		d.sd.flags.d_dcnt_p = 1U;
-		break;
-	case DT_JDN:
-		that = dt_dtconv((dt_dttyp_t)DT_DAISY, that);
-		goto daisy_prep;
-	case DT_LDN:
-		that = dt_dtconv((dt_dttyp_t)DT_DAISY, that);
-		goto daisy_prep;
-	case DT_MDN:
-		that = dt_dtconv((dt_dttyp_t)DT_DAISY, that);
-		goto daisy_prep;
-	case DT_DAISY:
-	daisy_prep:
-		__prep_strfd_daisy(&d.sd, that.d.daisy);
-		break;
-
-	case DT_BIZDA:
-		__prep_strfd_bizda(
-			&d.sd, that.d.bizda, __get_bizda_param(that.d));
-		break;
+	/* assign and go */
+	bp = buf;
+	fp = fmt;
+	for (char *const eo = buf + bsz; *fp && bp < eo;) {
+		const struct dt_fmtop_s op = __tok_op(fp, &fp);
 
-	case DT_SEXY:
-		/* instead of leaving this as SEXY turn it into
-		 * DAISY/HMS sandwich */
-		that = dt_dtconv((dt_dttyp_t)DT_DAISY, that);
-		/* prep d.sd */
-		goto daisy_prep;
-	case DT_YMDHMS:
-		/* convert this to a YMD/HMS sandwich */
-		that = dt_dtconv((dt_dttyp_t)DT_YMD, that);
-		/* prep d.sd */
-		goto ymd_prep;
+		bp += __strfdt_op(bp, eo - bp, op, &d, that);
+	}
+out:
+	if (bp < buf + bsz) {
+		*bp = '\0';
+	}
+	return bp - buf;
+}
 
-	default:
-	case DT_DUNK:
-		if (!dt_sandwich_only_t_p(that)) {
-			bp = buf;
-			goto out;
+DEFUN dt_fmtprog_t
+dt_strfdt_compile(const char *fmt)
+{
+	struct dt_fmtprog_s *res;
+	size_t flen = fmt ? strlen(fmt) : 0U;
+	size_t nop = 0U;
+
+	/* there's at most one op per format character,
+	 * plus room for the format itself behind the ops */
+	res = malloc(sizeof(*res) + flen * sizeof(*res->op) + flen + 1U);
+	if (UNLIKELY(res == NULL)) {
+		return NULL;
+	}
+	res->typ = (dt_dttyp_t)DT_UNK;
+	res->fbp = 0U;
+	res->milfupp = 0U;
+	res->dflt = NULL;
+	res->fmt = fmt ? memcpy(res->op + flen, fmt, flen + 1U) : NULL;
+	res->nop = 0U;
+
+	if (fmt != NULL && LIKELY(*fmt == '%')) {
+		/* proper format */
+		for (const char *fp = fmt; *fp; nop++) {
+			res->op[nop] = __tok_op(fp, &fp);
+		}
+		res->milfupp = need_milfup_p(fmt);
+		res->nop = nop;
+	} else if (fmt == NULL ||
+		   (res->typ = (dt_dttyp_t)__trans_dfmt_special(fmt)) !=
+		   (dt_dttyp_t)DT_UNK) {
+		/* calendar default formats, one program each */
+		static const char *const dflt[NSTRF_DFLT] = {
+			[STRF_YMDHMS] = ymdhms_dflt,
+			[STRF_YMCWHMS] = ymcwhms_dflt,
+			[STRF_YWDHMS] = ywdhms_dflt,
+			[STRF_YDHMS] = ydhms_dflt,
+			[STRF_BIZDAHMS] = bizdahms_dflt,
+			[STRF_YMD] = ymd_dflt,
+			[STRF_YMCW] = ymcw_dflt,
+			[STRF_YWD] = ywd_dflt,
+			[STRF_YD] = yd_dflt,
+			[STRF_BIZDA] = bizda_dflt,
+		};
+
+		res->dflt = calloc(NSTRF_DFLT, sizeof(*res->dflt));
+		if (UNLIKELY(res->dflt == NULL)) {
+			goto nomem;
+		}
+		for (size_t i = 0U; i < NSTRF_DFLT; i++) {
+			if ((res->dflt[i] = dt_strfdt_compile(dflt[i])) == NULL) {
+				goto nomem;
+			}
 		}
+	} else {
+		/* odd one, like hms, leave it to dt_strfdt() */
+		res->fbp = 1U;
 	}
+	return res;
 
-	if (dt_sandwich_p(that) || dt_sandwich_only_t_p(that)) {
-		/* cope with the time part */
-		d.st.h = that.t.hms.h;
-		d.st.m = that.t.hms.m;
-		d.st.s = that.t.hms.s;
-		d.st.ns = that.t.hms.ns;
+nomem:
+	dt_strfdt_free(res);
+	return NULL;
+}
+
+DEFUN void
+dt_strfdt_free(dt_fmtprog_t prog)
+{
+	if (prog != NULL && prog->dflt != NULL) {
+		for (size_t i = 0U; i < NSTRF_DFLT; i++) {
+			dt_strfdt_free(prog->dflt[i]);
+		}
+		free(prog->dflt);
 	}
+	free(prog);
+	return;
+}
 
-	/* assign and go */
-	bp = buf;
-	fp = fmt;
-	for (char *const eo = buf + bsz; *fp && bp < eo;) {
-		const char *fp_sav = fp;
-		struct dt_spec_s spec = __tok_spec(fp_sav, &fp);
+DEFUN size_t
+dt_strfdt_prog(
+	char *restrict buf, size_t bsz,
+	dt_fmtprog_t prog, struct dt_dt_s that)
+{
+	struct strpdt_s d = {0};
+	char *bp = buf;
 
-		if (spec.spfl == DT_SPFL_UNK) {
-			/* must be literal then */
-			*bp++ = *fp_sav;
-		} else if (LIKELY(!spec.rom)) {
-			bp += __strfdt_card(bp, eo - bp, spec, &d, that);
-			if (spec.ord) {
-				bp += __ordtostr(bp, eo - bp);
-			} else if (spec.bizda) {
-				/* don't print the b after an ordinal */
-				if (spec.ab == BIZDA_AFTER) {
-					*bp++ = 'b';
-				} else {
-					*bp++ = 'B';
-				}
+	if (UNLIKELY(buf == NULL || bsz == 0)) {
+		goto out;
+	} else if (UNLIKELY(prog == NULL)) {
+		/* bugger */
+		return dt_strfdt(buf, bsz, NULL, that);
+	} else if (prog->dflt != NULL) {
+		/* pick the calendar's default program */
+		const struct dt_dt_s orig = that;
+		size_t i;
+
+		if (prog->typ != (dt_dttyp_t)DT_UNK) {
+			that = dt_dtconv(prog->typ, that);
+		}
+		if (dt_sandwich_p(that)) {
+			switch (that.typ) {
+			case DT_YMD:
+			case DT_DAISY:
+			case DT_SEXY:
+			case DT_YMDHMS:
+				i = STRF_YMDHMS;
+				break;
+			case DT_YMCW:
+				i = STRF_YMCWHMS;
+				break;
+			case DT_YWD:
+				i = STRF_YWDHMS;
+				break;
+			case DT_YD:
+				i = STRF_YDHMS;
+				break;
+			case DT_BIZDA:
+				i = STRF_BIZDAHMS;
+				break;
+			case DT_JDN:
+			case DT_LDN:
+			case DT_MDN:
+				goto strf_xian;
+			default:
+				goto fallback;
+			}
+		} else if (dt_sandwich_only_d_p(that)) {
+			switch (that.d.typ) {
+			case DT_YMD:
+			case DT_DAISY:
+				i = STRF_YMD;
+				break;
+			case DT_YMCW:
+				i = STRF_YMCW;
+				break;
+			case DT_YWD:
+				i = STRF_YWD;
+				break;
+			case DT_YD:
+				i = STRF_YD;
+				break;
+			case DT_BIZDA:
+				i = STRF_BIZDA;
+				break;
+			case DT_JDN:
+			case DT_LDN:
+			case DT_MDN:
+				goto strf_xian;
+			default:
+				goto fallback;
 			}
-		} else if (UNLIKELY(spec.rom)) {
-			bp += __strfd_rom(bp, eo - bp, spec, &d.sd, that.d);
+		} else if (that.typ >= DT_PACK && that.typ < DT_NDTTYP) {
+			/* must be sexy or ymdhms */
+			i = STRF_YMDHMS;
+		} else {
+		fallback:
+			/* time-only values and other oddities */
+			return dt_strfdt(buf, bsz, prog->fmt, orig);
 		}
+		prog = prog->dflt[i];
+	} else if (UNLIKELY(prog->fbp)) {
+		/* it's one of the odd ones */
+		return dt_strfdt(buf, bsz, prog->fmt, that);
+	}
+
+	if (__strfdt_prep(&d, &that, prog->milfupp) < 0) {
+		goto out;
+	}
+	for (size_t i = 0U, n = prog->nop; i < n && bp < buf + bsz; i++) {
+		bp += __strfdt_op(bp, buf + bsz - bp, prog->op[i], &d, that);
 	}
 out:
 	if (bp < buf + bsz) {
 		*bp = '\0';
 	}
 	return bp - buf;
+
+strf_xian:
+	/* short cut, just print the guy here */
+	bp = buf + __strfdt_xdn(buf, bsz, that);
+	goto out;
 }
 
 DEFUN struct dt_dtdur_s
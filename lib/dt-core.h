@@ -216,6 +216,21 @@ struct dt_dtdur_s {
 	};
 };
 
+/* compiled input formats */
+typedef struct dt_fmtprog_s *dt_fmtprog_t;
+
+/* shapes of strings accepted by compiled input formats,
+ * for the first DT_SHAPE_LEN bytes */
+#define DT_SHAPE_LEN	(16U)
+
+struct dt_shape_s {
+	/* number of leading positions with known byte sets,
+	 * positions beyond that accept anything */
+	size_t len;
+	/* acceptable bytes per position, as 256-bit sets */
+	uint64_t set[DT_SHAPE_LEN][4U];
+};
+
 
 /* decls */
 /**
@@ -234,11 +249,53 @@ struct dt_dtdur_s {
 extern struct dt_dt_s
 dt_strpdt(const char *str, const char *fmt, char **ep);
 
+/**
+ * Compile input format FMT (as accepted by dt_strpdt()) into a program
+ * that can be run repeatedly by dt_strpdt_prog() without tokenising
+ * FMT over and over again.
+ * The standard format (FMT is NULL) compiles to a shared program,
+ * running the NULL program has the same effect.
+ * Return NULL if memory ran out.
+ * Programs are to be freed with dt_strpdt_free(). */
+extern dt_fmtprog_t dt_strpdt_compile(const char *fmt);
+
+/**
+ * Free a program as obtained by dt_strpdt_compile(). */
+extern void dt_strpdt_free(dt_fmtprog_t);
+
+/**
+ * Like dt_strpdt() but use the compiled format program PROG. */
+extern struct dt_dt_s
+dt_strpdt_prog(dt_fmtprog_t prog, const char *str, char **ep);
+
+/**
+ * Compute the shape of strings that can possibly be parsed by PROG.
+ * Strings whose leading bytes don't fit TGT will definitely fail
+ * dt_strpdt_prog(), the converse isn't true. */
+extern void dt_strpdt_shape(struct dt_shape_s *tgt, dt_fmtprog_t prog);
+
 /**
  * Like strftime() for our dates */
 extern size_t
 dt_strfdt(char *restrict buf, size_t bsz, const char *fmt, struct dt_dt_s);
 
+/**
+ * Compile output format FMT (as accepted by dt_strfdt()) into a program
+ * for dt_strfdt_prog().  Named calendars and the NULL format resolve to
+ * the calendars' default formats.
+ * Programs are to be freed with dt_strfdt_free(). */
+extern dt_fmtprog_t dt_strfdt_compile(const char *fmt);
+
+/**
+ * Free a program as obtained by dt_strfdt_compile(). */
+extern void dt_strfdt_free(dt_fmtprog_t);
+
+/**
+ * Like dt_strfdt() but use the compiled format program PROG. */
+extern size_t
+dt_strfdt_prog(
+	char *restrict buf, size_t bsz, dt_fmtprog_t prog, struct dt_dt_s);
+
 /**
  * Parse durations as in 1w5d, etc. */
 extern struct dt_dtdur_s
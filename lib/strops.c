@@ -51,6 +51,13 @@
 #endif	/* HAVE_SYS_STDINT_H */
 #include "nifty.h"
 #include "strops.h"
+#if defined __SSE2__
+# include <emmintrin.h>
+#endif	/* __SSE2__ */
+#if defined __x86_64__ && defined __GNUC__
+# include <immintrin.h>
+# define HAVE_XMEMPBRK_DISPATCH
+#endif	/* __x86_64__ && __GNUC__ */
 
 #if defined __INTEL_COMPILER
 /* we MUST return a char* */
@@ -496,6 +503,153 @@ xmempbrk(const char *src, size_t len, const char *set)
 	return (char*)src + i;
 }
 
+DEFUN void
+xmempbrk_init(struct xmempbrk_s *tgt, const char *set)
+{
+	memset(tgt, 0, sizeof(*tgt));
+	for (const unsigned char *sp = (const unsigned char*)set; *sp; sp++) {
+		if (tgt->tbl[*sp / 64U] >> (*sp % 64U) & 1U) {
+			/* dupe */
+			continue;
+		} else if (tgt->n < countof(tgt->set)) {
+			tgt->set[tgt->n] = *sp;
+		}
+		tgt->tbl[*sp / 64U] |= 1ULL << (*sp % 64U);
+		tgt->nib[*sp >> 7U][*sp & 0xfU] |= 1U << (*sp >> 4U & 0x7U);
+		tgt->n++;
+	}
+	return;
+}
+
+/* vector scanners, they return the offset of the first byte in SET or,
+ * if there's none, how far they got */
+#if defined __SSE2__
+static size_t
+xmempbrk_sse2(const char *src, size_t len, const struct xmempbrk_s *set)
+{
+	__m128i s[countof(set->set)];
+	size_t i = 0U;
+
+	for (unsigned int k = 0U; k < set->n; k++) {
+		s[k] = _mm_set1_epi8((char)set->set[k]);
+	}
+	for (; i + sizeof(__m128i) <= len; i += sizeof(__m128i)) {
+		const __m128i x = _mm_loadu_si128((const void*)(src + i));
+		__m128i m = _mm_setzero_si128();
+		unsigned int msk;
+
+		for (unsigned int k = 0U; k < set->n; k++) {
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(x, s[k]));
+		}
+		if ((msk = (unsigned int)_mm_movemask_epi8(m))) {
+			return i + __builtin_ctz(msk);
+		}
+	}
+	return i;
+}
+#endif	/* __SSE2__ */
+
+#if defined HAVE_XMEMPBRK_DISPATCH
+/* nibble lookup scanners for sets of any size, the low nibble of a byte
+ * picks a row of SET->nib, its high nibble the bit in that row, bytes
+ * with the top bit set index the second table, pshufb zeroes them in the
+ * first one and vice versa */
+static __attribute__((target("ssse3"))) size_t
+xmempbrk_ssse3(const char *src, size_t len, const struct xmempbrk_s *set)
+{
+	const __m128i t0 = _mm_loadu_si128((const void*)set->nib[0U]);
+	const __m128i t1 = _mm_loadu_si128((const void*)set->nib[1U]);
+	const __m128i bit = _mm_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m128i m8f = _mm_set1_epi8((char)0x8f);
+	const __m128i m80 = _mm_set1_epi8((char)0x80);
+	const __m128i m0f = _mm_set1_epi8(0x0f);
+	size_t i = 0U;
+
+	for (; i + sizeof(__m128i) <= len; i += sizeof(__m128i)) {
+		const __m128i x = _mm_loadu_si128((const void*)(src + i));
+		const __m128i l = _mm_and_si128(x, m8f);
+		const __m128i h = _mm_and_si128(_mm_srli_epi16(x, 4), m0f);
+		const __m128i row = _mm_or_si128(
+			_mm_shuffle_epi8(t0, l),
+			_mm_shuffle_epi8(t1, _mm_xor_si128(l, m80)));
+		const __m128i m = _mm_cmpeq_epi8(
+			_mm_and_si128(row, _mm_shuffle_epi8(bit, h)),
+			_mm_setzero_si128());
+		unsigned int msk;
+
+		if ((msk = (unsigned int)_mm_movemask_epi8(m) ^ 0xffffU)) {
+			return i + __builtin_ctz(msk);
+		}
+	}
+	return i;
+}
+
+static __attribute__((target("avx2"))) size_t
+xmempbrk_avx2(const char *src, size_t len, const struct xmempbrk_s *set)
+{
+	const __m256i t0 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const void*)set->nib[0U]));
+	const __m256i t1 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const void*)set->nib[1U]));
+	const __m256i bit = _mm256_setr_epi8(
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+		1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+	const __m256i m8f = _mm256_set1_epi8((char)0x8f);
+	const __m256i m80 = _mm256_set1_epi8((char)0x80);
+	const __m256i m0f = _mm256_set1_epi8(0x0f);
+	size_t i = 0U;
+
+	for (; i + sizeof(__m256i) <= len; i += sizeof(__m256i)) {
+		const __m256i x = _mm256_loadu_si256((const void*)(src + i));
+		const __m256i l = _mm256_and_si256(x, m8f);
+		const __m256i h = _mm256_and_si256(_mm256_srli_epi16(x, 4), m0f);
+		const __m256i row = _mm256_or_si256(
+			_mm256_shuffle_epi8(t0, l),
+			_mm256_shuffle_epi8(t1, _mm256_xor_si256(l, m80)));
+		const __m256i m = _mm256_cmpeq_epi8(
+			_mm256_and_si256(row, _mm256_shuffle_epi8(bit, h)),
+			_mm256_setzero_si256());
+		unsigned int msk;
+
+		if ((msk = (unsigned int)_mm256_movemask_epi8(m) ^ 0xffffffffU)) {
+			return i + __builtin_ctz(msk);
+		}
+	}
+	return i;
+}
+#endif	/* HAVE_XMEMPBRK_DISPATCH */
+
+DEFUN char*
+xmempbrk_r(const char *src, size_t len, const struct xmempbrk_s *set)
+{
+/* sets are looked up by nibbles, a whole vector at a time, AVX2 if the
+ * CPU has it, without SSSE3 sets of up to 16 bytes are compared instead,
+ * bigger ones and the remainder go through the bitmap */
+	size_t i = 0U;
+
+#if defined HAVE_XMEMPBRK_DISPATCH
+	if (__builtin_cpu_supports("avx2")) {
+		i = xmempbrk_avx2(src, len, set);
+	} else if (__builtin_cpu_supports("ssse3")) {
+		i = xmempbrk_ssse3(src, len, set);
+	} else
+#endif	/* HAVE_XMEMPBRK_DISPATCH */
+#if defined __SSE2__
+	if (set->n <= countof(set->set)) {
+		i = xmempbrk_sse2(src, len, set);
+	}
+#endif	/* __SSE2__ */
+	for (; i < len; i++) {
+		const unsigned char c = (unsigned char)src[i];
+
+		if (set->tbl[c / 64U] >> (c % 64U) & 1U) {
+			break;
+		}
+	}
+	return (char*)src + i;
+}
+
 #if defined __INTEL_COMPILER
 # pragma warning (default:2203)
 #elif defined __GNUC__
@@ -124,6 +124,29 @@ xstrpbrkp(const char *src, const char *set, size_t *set_offs);
 extern char*
 xmempbrk(const char *src, size_t len, const char *set);
 
+/* precompiled sets for xmempbrk_r() */
+struct xmempbrk_s {
+	/* number of bytes in the set, they're listed in SET if <= 16 */
+	unsigned int n;
+	unsigned char set[16U];
+	/* membership bitmap */
+	uint64_t tbl[4U];
+	/* the bitmap by nibbles, bit H % 8 of NIB[H / 8][L] is set
+	 * iff byte H << 4 | L is in the set */
+	unsigned char nib[2U][16U];
+};
+
+/**
+ * Compile the bytes in SET into TGT for use with xmempbrk_r(). */
+extern void
+xmempbrk_init(struct xmempbrk_s *tgt, const char *set);
+
+/**
+ * Like xmempbrk() but use the precompiled SET.
+ * Unlike xmempbrk() this one is reentrant. */
+extern char*
+xmempbrk_r(const char *src, size_t len, const struct xmempbrk_s *set);
+
 
 static inline char
 ui2c(uint32_t x, char pad)
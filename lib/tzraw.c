@@ -130,6 +130,33 @@ struct zlp_s {
 	int32_t corr;
 };
 
+/* POSIX TZ rule dates, Jn, n or Mm.w.d, and the local time of day */
+struct zrdt_s {
+	char typ;
+	uint8_t m;
+	uint8_t w;
+	uint8_t d;
+	uint16_t n;
+	int32_t tod;
+};
+
+/* the POSIX TZ rule in the footer of v2+ files, if it has DST */
+struct zrule_s {
+	/* offsets in standard and daylight saving time */
+	zof_t std;
+	zof_t dst;
+	/* dst starts at BEG (in standard time) and ends at END (in dst) */
+	struct zrdt_s beg;
+	struct zrdt_s end;
+};
+
+/* transitions generated from a rule */
+struct zrtr_s {
+	stamp_t t;
+	/* offsets before and after */
+	zof_t a, b;
+};
+
 /* leap second support missing as we do our own, see leaps.[ch] */
 struct zif_s {
 	size_t ntr;
@@ -138,6 +165,9 @@ struct zif_s {
 
 	/* NTR transitions */
 	stamp_t *trs;
+	/* NTR transitions in local time, from LCL[i] on the offset
+	 * after the i-th transition applies, see __loffs() */
+	stamp_t *lcl;
 	/* NTR types */
 	zty_t *tys;
 	/* NTY type array, transition details */
@@ -148,8 +178,27 @@ struct zif_s {
 	/* for special zones */
 	coord_zone_t cz;
 
-	/* zone caching, between PREV and NEXT the offset is OFFS */
-	struct zrng_s cache;
+	/* serial number, tells reincarnations at the same address apart */
+	unsigned int ser;
+
+	/* NBK buckets of 2^ZIF_BKT_BITS seconds, starting at BK0 << BITS,
+	 * BIX[i] is the last transition at or before the start of bucket i */
+	size_t nbk;
+	stamp_t bk0;
+	uint16_t *bix;
+
+	/* largest offset in the zone */
+	zof_t omax;
+
+	/* whether RULE is to be used past the last transition */
+	bool rulep;
+	struct zrule_s rule;
+	/* NRT transitions of RULE following the last transition, in UTC
+	 * and local time, and the offsets after them */
+	size_t nrt;
+	stamp_t *rtr;
+	stamp_t *rlc;
+	zof_t *rof;
 
 	stamp_t data[0] __attribute__((aligned(16)));
 };
@@ -161,9 +210,21 @@ static const char tzdir[] = TZDIR;
 static const char tzdir[] = "/usr/share/zoneinfo";
 #endif
 
+/* buckets of about 18 hours, transitions tend to be months apart */
+#define ZIF_BKT_BITS	(16U)
+/* don't bother indexing more than ~2000 years */
+#define ZIF_MAX_NBK	(1U << 20U)
+/* years of rule transitions to materialise past the last transition */
+#define ZIF_RULE_YEARS	(256U)
+/* average length of a gregorian year */
+#define ZIF_AVG_YEAR	(31556952)
+
 #define PROT_MEMMAP	PROT_READ | PROT_WRITE
 #define MAP_MEMMAP	MAP_PRIVATE | MAP_ANON
 
+/* serial numbers handed out by zif_open() and zif_copy() */
+static unsigned int zif_ser;
+
 /* special zone names */
 static const char coord_zones[][4] = {
 	"",
@@ -311,6 +372,250 @@ __open_zif(const char *file)
 }
 
 
+static inline zof_t
+__lpick(zof_t a, zof_t b)
+{
+/* of the offsets A (before) and B (after a transition) return the one
+ * that determines the wall clock reading at which the offset changes,
+ * in gaps and overlaps the offset closer to UTC wins */
+	const zof_t lo = a < b ? a : b;
+	const zof_t hi = a < b ? b : a;
+	const bool bp = (b < 0 ? -b : b) < (a < 0 ? -a : a);
+
+	return bp ? lo : hi;
+}
+
+static const char*
+__rule_offs(int32_t *tgt, const char *s, const char *ep)
+{
+/* read [+-]hh[:mm[:ss]] from S, hours can go up to 167 */
+	int32_t sgn = 1;
+	int32_t r = 0;
+
+	if (s < ep && (*s == '+' || *s == '-')) {
+		sgn = *s++ == '-' ? -1 : 1;
+	}
+	if (s >= ep || *s < '0' || *s > '9') {
+		return NULL;
+	}
+	for (int i = 0; i < 3; i++) {
+		int32_t x = 0;
+
+		if (i && (s >= ep || *s != ':')) {
+			break;
+		} else if (i) {
+			s++;
+		}
+		for (; s < ep && *s >= '0' && *s <= '9'; s++) {
+			x = 10 * x + (*s - '0');
+		}
+		r += x * (i == 0 ? 3600 : i == 1 ? 60 : 1);
+	}
+	if (r > 167 * 3600) {
+		return NULL;
+	}
+	*tgt = sgn * r;
+	return s;
+}
+
+static const char*
+__rule_name(const char *s, const char *ep)
+{
+/* skip zone abbreviations, alphabetic or quoted in <> */
+	const char *sp = s;
+
+	if (s < ep && *s == '<') {
+		for (; s < ep && *s != '>'; s++);
+		return s < ep ? s + 1 : NULL;
+	}
+	for (; s < ep && ((*s | 0x20) >= 'a' && (*s | 0x20) <= 'z'); s++);
+	return s - sp >= 3 ? s : NULL;
+}
+
+static const char*
+__rule_date(struct zrdt_s *tgt, const char *s, const char *ep)
+{
+/* read Jn, n or Mm.w.d, optionally followed by /time */
+	unsigned int x[3U] = {0U};
+	size_t nx = 1U;
+
+	if (s >= ep) {
+		return NULL;
+	} else if ((tgt->typ = *s) == 'J' || *s == 'M') {
+		s++;
+	} else {
+		tgt->typ = 'n';
+	}
+	for (size_t i = 0U; i < countof(x); i++) {
+		if (i && (tgt->typ != 'M' || s >= ep || *s != '.')) {
+			break;
+		} else if (i) {
+			s++;
+			nx++;
+		}
+		if (s >= ep || *s < '0' || *s > '9') {
+			return NULL;
+		}
+		for (; s < ep && *s >= '0' && *s <= '9'; s++) {
+			x[i] = 10U * x[i] + (*s - '0');
+		}
+	}
+	switch (tgt->typ) {
+	case 'J':
+		if (!x[0U] || x[0U] > 365U) {
+			return NULL;
+		}
+		break;
+	case 'n':
+		if (x[0U] > 365U) {
+			return NULL;
+		}
+		break;
+	case 'M':
+		if (nx < 3U || !x[0U] || x[0U] > 12U ||
+		    !x[1U] || x[1U] > 5U || x[2U] > 6U) {
+			return NULL;
+		}
+		break;
+	}
+	tgt->n = (uint16_t)x[0U];
+	tgt->m = (uint8_t)x[0U];
+	tgt->w = (uint8_t)x[1U];
+	tgt->d = (uint8_t)x[2U];
+	/* time of day, defaults to 02:00:00 */
+	tgt->tod = 7200;
+	if (s < ep && *s == '/') {
+		s = __rule_offs(&tgt->tod, s + 1, ep);
+	}
+	return s;
+}
+
+static bool
+__rule_parse(struct zrule_s *tgt, const char *s, const char *ep)
+{
+/* parse the POSIX TZ string between S and EP, e.g.
+ * CET-1CEST,M3.5.0,M10.5.0/3
+ * offsets in TZ strings count westwards, ours eastwards
+ * return true if there's a DST rule */
+	int32_t o;
+
+	if ((s = __rule_name(s, ep)) == NULL ||
+	    (s = __rule_offs(&o, s, ep)) == NULL) {
+		return false;
+	}
+	tgt->std = -o;
+	if ((s = __rule_name(s, ep)) == NULL) {
+		/* no dst, nothing to worry about */
+		return false;
+	}
+	tgt->dst = tgt->std + 3600;
+	if (s < ep && *s != ',') {
+		if ((s = __rule_offs(&o, s, ep)) == NULL) {
+			return false;
+		}
+		tgt->dst = -o;
+	}
+	/* we don't guess the rule if it's missing */
+	if (s >= ep || *s++ != ',' ||
+	    (s = __rule_date(&tgt->beg, s, ep)) == NULL ||
+	    s >= ep || *s++ != ',' ||
+	    (s = __rule_date(&tgt->end, s, ep)) == NULL) {
+		return false;
+	}
+	return s == ep;
+}
+
+static stamp_t
+__days_from_civil(stamp_t y, unsigned int m, unsigned int d)
+{
+/* days since 1970-01-01 of Y-M-D in the proleptic gregorian calendar */
+	y -= m <= 2U;
+	{
+		const stamp_t era = (y >= 0 ? y : y - 399) / 400;
+		const unsigned int yoe = (unsigned int)(y - era * 400);
+		const unsigned int doy =
+			(153U * (m > 2U ? m - 3U : m + 9U) + 2U) / 5U + d - 1U;
+		const unsigned int doe =
+			yoe * 365U + yoe / 4U - yoe / 100U + doy;
+
+		return era * 146097 + (stamp_t)doe - 719468;
+	}
+}
+
+static int
+__year_of(stamp_t t)
+{
+/* the (proleptic gregorian) year T is in */
+	const stamp_t dd = (t >= 0 ? t : t - 86399) / 86400 + 719468;
+	const stamp_t era = (dd >= 0 ? dd : dd - 146096) / 146097;
+	const unsigned int doe = (unsigned int)(dd - era * 146097);
+	const unsigned int yoe =
+		(doe - doe / 1460U + doe / 36524U - doe / 146096U) / 365U;
+	const unsigned int doy = doe - (365U * yoe + yoe / 4U - yoe / 100U);
+	const unsigned int mp = (5U * doy + 2U) / 153U;
+
+	return (int)(yoe + era * 400) + (mp >= 10U);
+}
+
+static stamp_t
+__rule_when(const struct zrdt_s r[static 1U], int y)
+{
+/* local time of rule date R in year Y */
+	static const uint8_t mdays[] = {
+		31U, 28U, 31U, 30U, 31U, 30U, 31U, 31U, 30U, 31U, 30U, 31U,
+	};
+	const bool leapp = !(y % 4) && (y % 100 || !(y % 400));
+	stamp_t d;
+
+	switch (r->typ) {
+	case 'J':
+		/* Feb 29 doesn't count */
+		d = __days_from_civil(y, 1U, 1U) + r->n - 1 +
+			(leapp && r->n >= 60U);
+		break;
+	case 'n':
+		d = __days_from_civil(y, 1U, 1U) + r->n;
+		break;
+	default:
+	case 'M': {
+		const unsigned int md = mdays[r->m - 1U] + (r->m == 2U && leapp);
+		const stamp_t d1 = __days_from_civil(y, r->m, 1U);
+		/* 1970-01-01 was a Thursday */
+		const int wd1 = (int)((d1 % 7 + 7 + 4) % 7);
+		unsigned int dom = 1U + (r->d - wd1 + 7) % 7 + (r->w - 1U) * 7U;
+
+		for (; dom > md; dom -= 7U);
+		d = d1 + dom - 1;
+		break;
+	}
+	}
+	return d * 86400 + r->tod;
+}
+
+static void
+__rule_year(struct zrtr_s tr[static 2U], const struct zrule_s r[static 1U], int y)
+{
+/* the two transitions of rule R in year Y, in chronological order */
+	tr[0U] = (struct zrtr_s){
+		__rule_when(&r->beg, y) - r->std, r->std, r->dst};
+	tr[1U] = (struct zrtr_s){
+		__rule_when(&r->end, y) - r->dst, r->dst, r->std};
+	if (tr[1U].t < tr[0U].t) {
+		/* southern hemisphere */
+		const struct zrtr_s tmp = tr[0U];
+		tr[0U] = tr[1U];
+		tr[1U] = tmp;
+	}
+	return;
+}
+
+static inline stamp_t
+__rule_lcl(struct zrtr_s tr)
+{
+	return tr.t + __lpick(tr.a, tr.b);
+}
+
+
 DEFUN void
 zif_close(zif_t z)
 {
@@ -409,7 +714,11 @@ zif_open(const char *file)
 	res->tys = (zty_t*)(res->ofs + tmp.nty);
 	res->lps = NULL;
 	res->cz = cz;
-	res->cache = (struct zrng_s){0};
+	res->lcl = NULL;
+	res->nbk = 0U;
+	res->bix = NULL;
+	res->rulep = false;
+	res->nrt = 0U;
 	/* copy data (and bring to host order) */
 	beef = hdr + sizeof(struct zih_s);
 	switch (hdr[offsetof(struct zih_s, tzh_version)]) {
@@ -425,6 +734,20 @@ zif_open(const char *file)
 		for (size_t i = 0U; i < tmp.nty; i++) {
 			res->ofs[i] = RDI32(beef + 6U * i);
 		}
+		/* the footer follows the 64bit block */
+		beef += tmp.nty * (4U + 1U + 1U);
+		beef += RDU32(hdr + offsetof(struct zih_s, tzh_charcnt));
+		beef += tmp.nlp * (8U + 4U);
+		beef += RDU32(hdr + offsetof(struct zih_s, tzh_ttisstdcnt));
+		beef += RDU32(hdr + offsetof(struct zih_s, tzh_ttisgmtcnt));
+		if (beef < map + st.st_size && *beef++ == '\n') {
+			const char *fp = (const char*)beef;
+			const char *ep = memchr(
+				fp, '\n', map + st.st_size - beef);
+
+			res->rulep = ep != NULL &&
+				__rule_parse(&res->rule, fp, ep);
+		}
 		break;
 	case '\0':
 		for (size_t i = 0U; i < tmp.ntr; i++) {
@@ -451,6 +774,11 @@ zif_open(const char *file)
 		}
 	}
 	res->ntr = real_ntr;
+	/* get a compact copy with the bucket index built */
+	with (struct zif_s *tmz = res) {
+		res = zif_copy(tmz);
+		free(tmz);
+	}
 	return res;
 unmp:
 	munmap(map, st.st_size);
@@ -463,12 +791,30 @@ DEFUN zif_t
 zif_copy(zif_t z)
 {
 /* copy Z into a newly allocated zif_t object
- * if applicable also perform byte-order conversions */
+ * and (re)build the bucket index */
 	struct zif_s *res;
+	size_t nbk = 0U;
+	stamp_t bk0 = 0;
+	const size_t nrt = z->rulep ? 2U * ZIF_RULE_YEARS : 0U;
 
+	if (z->cz) {
+		/* coordinated zones are static and never change */
+		return z;
+	}
+	if (z->ntr > 1U && z->ntr <= UINT16_MAX) {
+		bk0 = z->trs[0U] >> ZIF_BKT_BITS;
+		nbk = (z->trs[z->ntr - 1U] >> ZIF_BKT_BITS) - bk0 + 1U;
+		/* keep the offsets array aligned */
+		nbk = nbk <= ZIF_MAX_NBK ? (nbk + 1U) & ~1U : 0U;
+	}
 	res = malloc(sizeof(*z) +
 		     z->ntr * sizeof(*z->trs) +
+		     z->ntr * sizeof(*z->lcl) +
+		     nrt * sizeof(*z->rtr) +
+		     nrt * sizeof(*z->rlc) +
+		     nbk * sizeof(*z->bix) +
 		     z->nty * sizeof(*z->ofs) +
+		     nrt * sizeof(*z->rof) +
 		     z->ntr * sizeof(*z->tys) +
 		     0);
 
@@ -481,15 +827,74 @@ zif_copy(zif_t z)
 	res->nty = z->nty;
 	res->nlp = z->nlp;
 	res->trs = (stamp_t*)(res->data + 0);
-	res->ofs = (zof_t*)(res->trs + z->ntr);
-	res->tys = (zty_t*)(res->ofs + z->nty);
+	res->lcl = (stamp_t*)(res->trs + z->ntr);
+	res->rtr = (stamp_t*)(res->lcl + z->ntr);
+	res->rlc = (stamp_t*)(res->rtr + nrt);
+	res->bix = (uint16_t*)(res->rlc + nrt);
+	res->ofs = (zof_t*)(res->bix + nbk);
+	res->rof = (zof_t*)(res->ofs + z->nty);
+	res->tys = (zty_t*)(res->rof + nrt);
 	res->lps = NULL;
 	res->cz = z->cz;
-	res->cache = (struct zrng_s){0};
+	res->ser = __atomic_add_fetch(&zif_ser, 1U, __ATOMIC_RELAXED);
+	res->rulep = z->rulep;
+	res->rule = z->rule;
 	/* ... and copy */
 	memcpy(res->trs, z->trs, z->ntr * sizeof(*z->trs));
 	memcpy(res->ofs, z->ofs, z->nty * sizeof(*z->ofs));
 	memcpy(res->tys, z->tys, z->ntr * sizeof(*z->tys));
+
+	/* bucket index, stamps before the first bucket never get here */
+	res->nbk = nbk;
+	res->bk0 = bk0;
+	for (size_t i = 0U, j = 0U; i < nbk; i++) {
+		const stamp_t s = (bk0 + (stamp_t)i) << ZIF_BKT_BITS;
+
+		for (; j + 1U < res->ntr && res->trs[j + 1U] <= s; j++);
+		res->bix[i] = (uint16_t)j;
+	}
+	if (!nbk) {
+		res->bix = NULL;
+	}
+
+	/* local time table, the wall clock reading at which the offset
+	 * changes, i.e. the start or the end of a gap or an overlap */
+	res->omax = INT_MIN;
+	for (size_t i = 0U; i < res->nty; i++) {
+		if (res->ofs[i] > res->omax) {
+			res->omax = res->ofs[i];
+		}
+	}
+	if (res->ntr) {
+		res->lcl[0U] = STAMP_MIN;
+	}
+	for (size_t i = 1U; i < res->ntr; i++) {
+		const zof_t a = _zif_troffs(res, i - 1U);
+		const zof_t b = _zif_troffs(res, i);
+		const stamp_t l = res->trs[i] + __lpick(a, b);
+
+		/* keep it sorted, should transitions ever be this close */
+		res->lcl[i] = l > res->lcl[i - 1U] ? l : res->lcl[i - 1U];
+	}
+
+	/* rule transitions from the year of the last transition on */
+	res->nrt = nrt;
+	with (int y = res->ntr ? __year_of(res->trs[res->ntr - 1U]) : 1970) {
+		for (size_t i = 0U; i < nrt; i += 2U, y++) {
+			struct zrtr_s tr[2U];
+
+			__rule_year(tr, &res->rule, y);
+			for (size_t j = 0U; j < 2U; j++) {
+				res->rtr[i + j] = tr[j].t;
+				res->rlc[i + j] = __rule_lcl(tr[j]);
+				res->rof[i + j] = tr[j].b;
+			}
+		}
+	}
+	if (!nrt) {
+		res->rtr = res->rlc = NULL;
+		res->rof = NULL;
+	}
 	return res;
 }
 
@@ -507,8 +912,16 @@ __find_trno(const struct zif_s z[static 1U], stamp_t t, int min, int max)
 		return -1;
 	} else if (UNLIKELY(t < zif_trans(z, min))) {
 		return -1;
-	} else if (UNLIKELY(t > zif_trans(z, max))) {
+	} else if (UNLIKELY(t >= zif_trans(z, max))) {
+		/* beyond the last transition, or exactly on it */
 		return max - 1;
+	} else if (LIKELY(z->bix != NULL && min == 0 && max == (int)z->ntr)) {
+		/* trs[0] <= t < trs[ntr - 1], so T's bucket exists and
+		 * the scan below stops before the last transition */
+		int this = z->bix[(t >> ZIF_BKT_BITS) - z->bk0];
+
+		for (; t >= z->trs[this + 1]; this++);
+		return this;
 	}
 
 	do {
@@ -541,12 +954,95 @@ zif_find_trans(zif_t z, stamp_t t)
 	return __find_trno(z, t, min, max);
 }
 
+static struct zrng_s
+__rule_calc(const struct zif_s z[static 1U], stamp_t t, bool localp)
+{
+/* find the range T belongs to according to Z's rule, where T is in
+ * local time if LOCALP and in UTC otherwise
+ * this is meant to be used past the last transition only */
+	const int y = __year_of(t);
+	struct zrtr_s tr[2U], ot[2U];
+	struct zrng_s res;
+	stamp_t k0, k1, lo;
+
+	__rule_year(tr, &z->rule, y);
+	k0 = localp ? __rule_lcl(tr[0U]) : tr[0U].t;
+	k1 = localp ? __rule_lcl(tr[1U]) : tr[1U].t;
+	if (t < k0) {
+		__rule_year(ot, &z->rule, y - 1);
+		res.prev = localp ? __rule_lcl(ot[1U]) : ot[1U].t;
+		res.next = k0;
+		res.offs = tr[0U].a;
+	} else if (t < k1) {
+		res.prev = k0;
+		res.next = k1;
+		res.offs = tr[0U].b;
+	} else {
+		__rule_year(ot, &z->rule, y + 1);
+		res.prev = k1;
+		res.next = localp ? __rule_lcl(ot[0U]) : ot[0U].t;
+		res.offs = tr[1U].b;
+	}
+	/* rules with very odd times of day could upset the above */
+	if (UNLIKELY(res.prev > t)) {
+		res.prev = t;
+	}
+	if (UNLIKELY(res.next <= t)) {
+		res.next = t + 1;
+	}
+	/* don't reach back into the transition table */
+	lo = !z->ntr ? STAMP_MIN : (localp ? z->lcl : z->trs)[z->ntr - 1U];
+	if (res.prev < lo) {
+		res.prev = lo;
+	}
+	res.trno = (uint8_t)(z->ntr ? z->ntr - 1U : 0U);
+	return res;
+}
+
+static struct zrng_s
+__rule_zrng(const struct zif_s z[static 1U], stamp_t t, bool localp)
+{
+/* like __rule_calc() but use the rule transitions materialised for the
+ * years after the last transition if T is covered by them */
+	const stamp_t *rt = localp ? z->rlc : z->rtr;
+	const size_t nrt = z->nrt;
+	struct zrng_s res;
+	stamp_t lo;
+	size_t k;
+
+	if (UNLIKELY(!nrt || t < rt[0U] || t >= rt[nrt - 1U])) {
+		return __rule_calc(z, t, localp);
+	}
+	/* two transitions a year, guess and then walk */
+	k = (size_t)((t - rt[0U]) / ZIF_AVG_YEAR) * 2U;
+	if (k >= nrt) {
+		k = nrt - 1U;
+	}
+	for (; rt[k] > t; k--);
+	for (; rt[k + 1U] <= t; k++);
+
+	res.prev = rt[k];
+	res.next = rt[k + 1U];
+	res.offs = z->rof[k];
+	/* don't reach back into the transition table */
+	lo = !z->ntr ? STAMP_MIN : (localp ? z->lcl : z->trs)[z->ntr - 1U];
+	if (res.prev < lo) {
+		res.prev = lo;
+	}
+	res.trno = (uint8_t)(z->ntr ? z->ntr - 1U : 0U);
+	return res;
+}
+
 static struct zrng_s
 __find_zrng(const struct zif_s z[static 1U], stamp_t t, int min, int max)
 {
 	struct zrng_s res;
 	int trno;
 
+	if (UNLIKELY(z->rulep && (!z->ntr || t >= z->trs[z->ntr - 1U]))) {
+		/* past the last transition, ask the rule */
+		return __rule_zrng(z, t, false);
+	}
 	trno = __find_trno(z, t, min, max);
 	res.prev = zif_trans(z, trno);
 	if (UNLIKELY(trno <= 0 && t < res.prev)) {
@@ -555,10 +1051,10 @@ __find_zrng(const struct zif_s z[static 1U], stamp_t t, int min, int max)
 		/* assume the first offset has always been there */
 		res.next = res.prev;
 	} else if (UNLIKELY(trno < 0)) {
-		/* special case where no transitions are recorded */
+		/* before the first transition, if any */
 		res.trno = 0U;
 		res.prev = STAMP_MIN;
-		res.next = STAMP_MAX;
+		res.next = z->ntr ? zif_trans(z, 0) : STAMP_MAX;
 	} else {
 		res.trno = (uint8_t)trno;
 		if (LIKELY(trno + 1U < z->ntr)) {
@@ -567,7 +1063,8 @@ __find_zrng(const struct zif_s z[static 1U], stamp_t t, int min, int max)
 			res.next = STAMP_MAX;
 		}
 	}
-	res.offs = _zif_troffs(z, res.trno);
+	/* RES.TRNO might be truncated */
+	res.offs = _zif_troffs(z, trno > 0 ? trno : 0);
 	return res;
 }
 
@@ -602,9 +1099,10 @@ __gps_offs(stamp_t t)
 }
 
 static stamp_t
-__offs(struct zif_s z[static 1U], stamp_t t)
+__offs(zif_cursor_t c[static 1U], stamp_t t)
 {
-/* return the offset of T in Z and cache the result. */
+/* return the offset of T in C's zone and cache the result in C. */
+	const struct zif_s *z = c->z;
 	int min;
 	size_t max;
 
@@ -621,53 +1119,227 @@ __offs(struct zif_s z[static 1U], stamp_t t)
 	}
 
 	/* use the classic code */
-	if (LIKELY(t >= z->cache.prev && t < z->cache.next)) {
+	if (LIKELY(t >= c->cache.prev && t < c->cache.next)) {
 		/* use the cached offset */
-		return z->cache.offs;
-	} else if (t >= z->cache.next) {
-		min = z->cache.trno + 1;
+		return c->cache.offs;
+	} else if (LIKELY(z->bix != NULL)) {
+		/* the bucket index beats any hints we could give */
+		min = 0;
 		max = z->ntr;
-	} else if (t < z->cache.prev) {
-		max = z->cache.trno;
+	} else if (UNLIKELY(c->cache.prev >= c->cache.next)) {
+		/* nothing cached yet */
+		min = 0;
+		max = z->ntr;
+	} else if (t >= c->cache.next) {
+		/* the cached trno may have been truncated, so it's a
+		 * lower bound at best, good enough for forward searches */
+		min = c->cache.trno + 1;
+		max = z->ntr;
+	} else if (LIKELY(z->ntr <= UINT8_MAX)) {
+		max = c->cache.trno;
 		min = 0;
 	} else {
-		/* we shouldn't end up here at all */
 		min = 0;
-		max = 0;
+		max = z->ntr;
+	}
+	return (c->cache = __find_zrng(z, t, min, max)).offs;
+}
+
+static stamp_t
+__loffs(zif_cursor_t c[static 1U], stamp_t t)
+{
+/* return the offset of T, given in local time, in C's zone and cache
+ * the result in C.
+ * Local times in a gap (that never happened on the wall clock) or in
+ * an overlap (that happened twice) get whichever of the two offsets
+ * is closer to UTC, i.e. the one of smaller magnitude, e.g. CET in
+ * Europe/Berlin but EDT in America/New_York. */
+	const struct zif_s *z = c->z;
+	int trno;
+
+	if (LIKELY(t >= c->lcache.prev && t < c->lcache.next)) {
+		/* use the cached offset */
+		return c->lcache.offs;
+	}
+	/* LCL[i] <= TRS[i] + OMAX, so this is a lower bound ... */
+	if ((trno = __find_trno(z, t - z->omax, 0, z->ntr)) < 0) {
+		trno = 0;
+	}
+	/* ... and at most a couple of transitions off */
+	for (; trno + 1U < z->ntr && z->lcl[trno + 1] <= t; trno++);
+
+	if (UNLIKELY(z->rulep && trno + 1U >= z->ntr &&
+		     (!z->ntr || t >= z->lcl[trno]))) {
+		/* past the last transition, ask the rule */
+		return (c->lcache = __rule_zrng(z, t, true)).offs;
+	}
+
+	c->lcache.prev = trno > 0 ? z->lcl[trno] : STAMP_MIN;
+	c->lcache.next = trno + 1U < z->ntr ? z->lcl[trno + 1] : STAMP_MAX;
+	c->lcache.trno = (uint8_t)trno;
+	return c->lcache.offs = _zif_troffs(z, trno);
+}
+
+/* cursors for the cursor-less API, one pair per thread, so that
+ * converting from one zone into another doesn't thrash the cache */
+static __thread struct {
+	zif_cursor_t c;
+	unsigned int ser;
+} tlc[2U];
+static __thread unsigned int tlh;
+
+static zif_cursor_t*
+__tl_cursor(zif_t z)
+{
+	if (LIKELY(tlc[tlh].c.z == z && tlc[tlh].ser == z->ser)) {
+		return &tlc[tlh].c;
+	}
+	/* try the other one */
+	tlh ^= 1U;
+	if (LIKELY(tlc[tlh].c.z == z && tlc[tlh].ser == z->ser)) {
+		return &tlc[tlh].c;
 	}
-	return (z->cache = __find_zrng(z, t, min, max)).offs;
+	/* evict the least recently used cursor */
+	tlc[tlh].c = zif_cursor(z);
+	tlc[tlh].ser = z->ser;
+	return &tlc[tlh].c;
+}
+
+DEFUN zif_cursor_t
+zif_cursor(zif_t z)
+{
+	/* a cache with PREV >= NEXT is empty */
+	return (zif_cursor_t){.z = z};
 }
 
 DEFUN stamp_t
-zif_utc_time(zif_t z, stamp_t t)
+zif_utc_time_c(zif_cursor_t *c, stamp_t t)
 {
-/* here's the setup, given t in local time, we denote the corresponding
- * UTC time by t' = t - x' where x' is the true offset
- * however, since we do not know the offset in advance, we have to solve
- * for an estimate of the offset x:
- * t - x + x' = t, or equivalently t - x = t' or as a root finding problem
- * x' - x = 0.
- * To make this iterative we just solve:
- * x_{i+1} - x_i = 0, where x_{i+1} = o(t - x_i) and o maps a given
- * time stamp to an offset. */
-/* make me use the cache please! */
-	/* let's go */
+/* for olson zones we look T up in the local transition table directly,
+ * see __loffs() for the treatment of gaps and overlaps.
+ * For coordinated zones we don't know the offset in advance and solve
+ * t - x + x' = t iteratively for x, where x' = o(t - x) and o maps a
+ * given time stamp to an offset. */
 	stamp_t xi = 0;
 	stamp_t xj;
 	stamp_t old = -1;
 
 	/* jump off the cliff if Z is nought */
-	if (UNLIKELY(z == NULL)) {
+	if (UNLIKELY(c->z == NULL)) {
 		return t;
+	} else if (LIKELY(c->z->cz == TZCZ_UNK)) {
+		return t - __loffs(c, t);
 	}
 
-	while ((xj = __offs(z, t - xi)) != xi && xi != old) {
+	while ((xj = __offs(c, t - xi)) != xi && xi != old) {
 		old = xi = xj;
 	}
 	return t - xj;
 }
 
 /* convert utc to local */
+DEFUN stamp_t
+zif_local_time_c(zif_cursor_t *c, stamp_t t)
+{
+	/* jump off the cliff if Z is nought */
+	if (UNLIKELY(c->z == NULL)) {
+		return t;
+	}
+	return t + __offs(c, t);
+}
+
+/* the number of sweeps in a row that cover a single stamp only
+ * before the batch conversions give up on sweeping */
+#define SWEEP_MAXSGL	(16U)
+
+DEFUN void
+zif_utc_time_v(zif_t z, const stamp_t *in, stamp_t *out, size_t n)
+{
+	zif_cursor_t c = zif_cursor(z);
+
+	/* jump off the cliff if Z is nought */
+	if (UNLIKELY(z == NULL)) {
+		memmove(out, in, n * sizeof(*in));
+		return;
+	} else if (UNLIKELY(z->cz != TZCZ_UNK)) {
+		/* no ranges to speak of, go one by one */
+		for (size_t i = 0U; i < n; i++) {
+			out[i] = zif_utc_time_c(&c, in[i]);
+		}
+		return;
+	}
+	for (size_t i = 0U, nsgl = 0U; i < n;) {
+		/* look up IN[i], then sweep over all that's in the same range */
+		const stamp_t o = __loffs(&c, in[i]);
+		const stamp_t lo = c.lcache.prev;
+		const stamp_t hi = c.lcache.next;
+		const size_t beg = i;
+
+		do {
+			out[i] = in[i] - o;
+		} while (++i < n && in[i] >= lo && in[i] < hi);
+
+		if (i - beg > 1U) {
+			nsgl = 0U;
+		} else if (UNLIKELY(++nsgl >= SWEEP_MAXSGL)) {
+			/* unsorted, the sweeps don't pay off, go one by one */
+			for (; i < n; i++) {
+				out[i] = in[i] - __loffs(&c, in[i]);
+			}
+		}
+	}
+	return;
+}
+
+DEFUN void
+zif_local_time_v(zif_t z, const stamp_t *in, stamp_t *out, size_t n)
+{
+	zif_cursor_t c = zif_cursor(z);
+
+	/* jump off the cliff if Z is nought */
+	if (UNLIKELY(z == NULL)) {
+		memmove(out, in, n * sizeof(*in));
+		return;
+	} else if (UNLIKELY(z->cz != TZCZ_UNK)) {
+		/* no ranges to speak of, go one by one */
+		for (size_t i = 0U; i < n; i++) {
+			out[i] = zif_local_time_c(&c, in[i]);
+		}
+		return;
+	}
+	for (size_t i = 0U, nsgl = 0U; i < n;) {
+		/* look up IN[i], then sweep over all that's in the same range */
+		const stamp_t o = __offs(&c, in[i]);
+		const stamp_t lo = c.cache.prev;
+		const stamp_t hi = c.cache.next;
+		const size_t beg = i;
+
+		do {
+			out[i] = in[i] + o;
+		} while (++i < n && in[i] >= lo && in[i] < hi);
+
+		if (i - beg > 1U) {
+			nsgl = 0U;
+		} else if (UNLIKELY(++nsgl >= SWEEP_MAXSGL)) {
+			/* unsorted, the sweeps don't pay off, go one by one */
+			for (; i < n; i++) {
+				out[i] = in[i] + __offs(&c, in[i]);
+			}
+		}
+	}
+	return;
+}
+
+DEFUN stamp_t
+zif_utc_time(zif_t z, stamp_t t)
+{
+	/* jump off the cliff if Z is nought */
+	if (UNLIKELY(z == NULL)) {
+		return t;
+	}
+	return zif_utc_time_c(__tl_cursor(z), t);
+}
+
 DEFUN stamp_t
 zif_local_time(zif_t z, stamp_t t)
 {
@@ -675,7 +1347,7 @@ zif_local_time(zif_t z, stamp_t t)
 	if (UNLIKELY(z == NULL)) {
 		return t;
 	}
-	return t + __offs(z, t);
+	return zif_local_time_c(__tl_cursor(z), t);
 }
 
 #endif	/* INCLUDED_tzraw_c_ */
@@ -38,6 +38,7 @@
 #if !defined INCLUDED_tzraw_h_
 #define INCLUDED_tzraw_h_
 
+#include <stddef.h>
 #include <stdint.h>
 #include "leaps.h"
 
@@ -122,6 +123,19 @@ struct zrng_s {
 	unsigned int trno:8;
 } __attribute__((packed));
 
+/**
+ * Lookup cursor for Z.
+ * Zones are immutable once opened and can be shared freely, the
+ * cursor carries the lookup cache and must be owned by one caller
+ * (thread) at a time.  Obtain one with zif_cursor(). */
+typedef struct {
+	zif_t z;
+	/* between PREV and NEXT the offset is OFFS */
+	struct zrng_s cache;
+	/* same in local time, for zif_utc_time_c() */
+	struct zrng_s lcache;
+} zif_cursor_t;
+
 
 /**
  * Open the zoneinfo file FILE.
@@ -134,9 +148,15 @@ extern zif_t zif_open(const char *file);
 extern void zif_close(zif_t);
 
 /**
- * Copy the zoneinfo structure. */
+ * Copy the zoneinfo structure.
+ * Zones are never written to after zif_open(), a copy is only needed
+ * if the original is to be closed independently. */
 extern zif_t zif_copy(zif_t);
 
+/**
+ * Return a fresh lookup cursor for Z. */
+extern zif_cursor_t zif_cursor(zif_t z);
+
 /**
  * Find the most recent transition in Z before T. */
 extern int zif_find_trans(zif_t z, stamp_t t);
@@ -146,13 +166,39 @@ extern int zif_find_trans(zif_t z, stamp_t t);
 extern struct zrng_s zif_find_zrng(zif_t z, stamp_t t);
 
 /**
- * Given T in local time specified by Z, return a T in UTC. */
+ * Given T in local time specified by Z, return a T in UTC.
+ * Local times that fall into a gap or that are ambiguous are resolved
+ * using the offset closer to UTC, i.e. the one of smaller magnitude,
+ * which needn't be standard time (think EDT in America/New_York). */
 extern stamp_t zif_utc_time(zif_t z, stamp_t t);
 
 /**
  * Given T in UTC, return a T in local time specified by Z. */
 extern stamp_t zif_local_time(zif_t z, stamp_t t);
 
+/**
+ * Like zif_utc_time() but use (and update) the lookup cache in C. */
+extern stamp_t zif_utc_time_c(zif_cursor_t *c, stamp_t t);
+
+/**
+ * Like zif_local_time() but use (and update) the lookup cache in C. */
+extern stamp_t zif_local_time_c(zif_cursor_t *c, stamp_t t);
+
+/**
+ * Convert N stamps IN, given in local time specified by Z, to UTC
+ * and put the results into OUT.  IN and OUT may be the same.
+ * Sorted input (or input with long runs in the same zone period)
+ * is converted in one forward sweep, other input stamp by stamp. */
+extern void
+zif_utc_time_v(zif_t z, const stamp_t *in, stamp_t *out, size_t n);
+
+/**
+ * Convert N stamps IN, given in UTC, to local time specified by Z
+ * and put the results into OUT.  IN and OUT may be the same.
+ * Like zif_utc_time_v() sorted input is converted in a sweep. */
+extern void
+zif_local_time_v(zif_t z, const stamp_t *in, stamp_t *out, size_t n);
+
 
 /* exposure for specific zif-inspecting tools (dzone(1) for one) */
 /**
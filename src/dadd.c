@@ -48,6 +48,7 @@
 #include "dt-core-tz-glue.h"
 #include "dt-locale.h"
 #include "prchunk.h"
+#include "dt-io-par.h"
 
 const char *prog = "dadd";
 
@@ -76,6 +77,8 @@ dadd_add(struct dt_dt_s d, struct dt_dtdur_s dur[], size_t ndur)
 struct mass_add_clo_s {
 	void *pctx;
 	const struct grep_atom_soa_s *gra;
+	char *const *fmt;
+	size_t nfmt;
 	struct __strpdtdur_st_s st;
 	struct dt_dt_s rd;
 	zif_t fromz;
@@ -85,21 +88,33 @@ struct mass_add_clo_s {
 	int sed_mode_p;
 	int empty_mode_p;
 	int quietp;
+	struct dt_io_fld_s fld;
 };
 
 static int
-proc_line(const struct mass_add_clo_s *clo, char *line, size_t llen)
+proc_line(void *arg, FILE *out, char *line, size_t llen)
 {
+	const struct mass_add_clo_s *clo = arg;
 	struct dt_dt_s d;
 	char *sp = NULL;
 	char *ep = NULL;
 	size_t nmatch = 0U;
 	int rc = 0;
-
+	/* the bit of the line we scan, all of it or just one field */
+	char *fp = line;
+	size_t flen = llen;
+	char fc = '\0';
+
+	if (clo->fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, clo->fld);
+		/* \0-terminate the field for the parsers, undone below */
+		fc = fp[flen];
+		fp[flen] = '\0';
+	}
 	do {
 		/* check if line matches, */
 		d = dt_io_find_strpdt2(
-			line, llen, clo->gra, &sp, &ep, clo->fromz);
+			fp, flen, clo->gra, &sp, &ep, clo->fromz);
 
 		if (!dt_unk_p(d)) {
 			if (UNLIKELY(d.fix) && !clo->quietp) {
@@ -114,26 +129,30 @@ proc_line(const struct mass_add_clo_s *clo, char *line, size_t llen)
 			}
 
 			if (clo->sed_mode_p) {
-				__io_write(line, sp - line, stdout);
-				dt_io_write(d, clo->ofmt, clo->z, '\0');
+				__io_write(line, sp - line, out);
+				dt_io_fwrite(d, clo->ofmt, clo->z, '\0', out);
+				flen -= (ep - fp);
 				llen -= (ep - line);
-				line = ep;
+				fp = line = ep;
 				nmatch++;
 			} else {
-				dt_io_write(d, clo->ofmt, clo->z, '\n');
+				dt_io_fwrite(d, clo->ofmt, clo->z, '\n', out);
 				break;
 			}
 		} else if (clo->sed_mode_p) {
+			/* put the field delimiter back */
+			fp[flen] = fc;
 			llen = !(clo->empty_mode_p && !nmatch) ? llen : 0U;
 			line[llen] = '\n';
-			__io_write(line, llen + 1, stdout);
+			__io_write(line, llen + 1, out);
 			break;
 		} else if (clo->empty_mode_p) {
-			__io_write("\n", 1U, stdout);
+			__io_write("\n", 1U, out);
 			break;
 		} else {
 			/* obviously unmatched, warn about it in non -q mode */
 			if (!clo->quietp) {
+				fp[flen] = fc;
 				dt_io_warn_strpdt(line);
 				rc = 2;
 			}
@@ -144,21 +163,42 @@ proc_line(const struct mass_add_clo_s *clo, char *line, size_t llen)
 }
 
 static int
-mass_add_dur(const struct mass_add_clo_s *clo)
+proc_exact(void *arg, FILE *out, char *line, size_t llen)
 {
-/* read lines from stdin
- * interpret as dates
- * add to reference duration
- * output */
-	size_t lno = 0;
-	int rc = 0;
+/* lines (or fields) must be a date/time in their entirety */
+	const struct mass_add_clo_s *clo = arg;
+	struct dt_dt_s d;
+	char *ep = NULL;
 
-	for (char *line; prchunk_haslinep(clo->pctx); lno++) {
-		size_t llen = prchunk_getline(clo->pctx, &line);
+	if (clo->fld.fld) {
+		llen = dt_io_getfld(&line, line, llen, clo->fld);
+		line[llen] = '\0';
+	}
+	if (UNLIKELY(!llen)) {
+		goto empty;
+	}
+	/* try and parse the line */
+	d = dt_io_strpdt_ep(line, clo->fmt, clo->nfmt, &ep, clo->fromz);
+	if (UNLIKELY(dt_unk_p(d))) {
+		goto empty;
+	} else if (ep && (unsigned)*ep >= ' ') {
+		goto empty;
+	}
+	/* do the adding */
+	d = dadd_add(d, clo->st.durs, clo->st.ndurs);
+	if (UNLIKELY(dt_unk_p(d))) {
+		goto empty;
+	}
 
-		rc |= proc_line(clo, line, llen);
+	if (clo->hackz == NULL && clo->fromz != NULL) {
+		/* fixup zone */
+		d = dtz_forgetz(d, clo->fromz);
 	}
-	return rc;
+	dt_io_fwrite(d, clo->ofmt, clo->z, '\n', out);
+	return 0;
+empty:
+	__io_write("\n", 1U, out);
+	return 0;
 }
 
 static int
@@ -176,16 +216,29 @@ mass_add_d(const struct mass_add_clo_s *clo)
 	for (char *line; prchunk_haslinep(clo->pctx); lno++) {
 		size_t llen;
 		int has_dur_p  = 1;
+		char *fp;
+		size_t flen;
+		char fc;
 
-		llen = prchunk_getline(clo->pctx, &line);
+		llen = prchunk_getline_rw(clo->pctx, &line);
+		if (UNLIKELY(line == NULL)) {
+			return -1;
+		}
+		/* only look at the field in question */
+		flen = dt_io_getfld(&fp, line, llen, clo->fld);
+		fc = fp[flen];
+		fp[flen] = '\0';
 
 		/* check for durations on this line */
 		do {
-			if (dt_io_strpdtdur(&st, line) < 0) {
+			if (dt_io_strpdtdur(&st, fp) < 0) {
 				has_dur_p = 0;
 			}
 		} while (__strpdtdur_more_p(&st));
 
+		/* and put the delimiter back */
+		fp[flen] = fc;
+
 		/* finish with newline again */
 		line[llen] = '\n';
 
@@ -235,6 +288,7 @@ main(int argc, char *argv[])
 	zif_t fromz = NULL;
 	zif_t z = NULL;
 	zif_t hackz = NULL;
+	struct dt_io_fld_s fld;
 
 	if (yuck_parse(argi, argc, argv)) {
 		rc = 1;
@@ -256,6 +310,11 @@ main(int argc, char *argv[])
 		}
 	}
 
+	if (dt_io_fld(&fld, argi->field_arg, argi->delimiter_arg) < 0) {
+		rc = 1;
+		goto out;
+	}
+
 	if (argi->from_locale_arg) {
 		setilocale(argi->from_locale_arg);
 	}
@@ -263,6 +322,10 @@ main(int argc, char *argv[])
 		setflocale(argi->locale_arg);
 	}
 
+	if (argi->stats_flag) {
+		dt_io_fmtstats_on();
+	}
+
 	/* try and read the from and to time zones */
 	if (argi->from_zone_arg &&
 	    (fromz = dt_io_zone(argi->from_zone_arg)) == NULL) {
@@ -337,93 +400,77 @@ Error: cannot interpret date/time string `%s'", inp);
 			rc = 1;
 		}
 
-	} else if (st.ndurs && !argi->sed_mode_flag && argi->empty_mode_flag) {
-		size_t lno = 0U;
-		void *pctx;
-
-		/* no threads reading this stream */
-		__io_setlocking_bycaller(stdout);
-
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("could not open stdin");
-			goto clear;
-		}
-
-		while (prchunk_fill(pctx) >= 0) {
-			for (char *line; prchunk_haslinep(pctx); lno++) {
-				size_t llen = prchunk_getline(pctx, &line);
-				char *ep = NULL;
-
-				if (UNLIKELY(!llen)) {
-					goto empty;
-				}
-				/* try and parse the line */
-				d = dt_io_strpdt_ep(line, fmt, nfmt, &ep, fromz);
-				if (UNLIKELY(dt_unk_p(d))) {
-					goto empty;
-				} else if (ep && (unsigned)*ep >= ' ') {
-					goto empty;
-				}
-				/* do the adding */
-				d = dadd_add(d, st.durs, st.ndurs);
-				if (UNLIKELY(dt_unk_p(d))) {
-					goto empty;
-				}
-
-				if (hackz == NULL && fromz != NULL) {
-					/* fixup zone */
-					d = dtz_forgetz(d, fromz);
-				}
-				dt_io_write(d, ofmt, z, '\n');
-				continue;
-			empty:
-				__io_write("\n", 1U, stdout);
-			}
-		}
 	} else if (st.ndurs) {
 		/* read dates from stdin */
 		struct grep_atom_s __nstk[16], *needle = __nstk;
 		size_t nneedle = countof(__nstk);
 		struct grep_atom_soa_s ndlsoa;
-		struct mass_add_clo_s clo[1];
-		void *pctx;
+		struct mass_add_clo_s proto = {
+			.gra = &ndlsoa,
+			.fmt = fmt,
+			.nfmt = nfmt,
+			.st = st,
+			.fromz = fromz,
+			.hackz = hackz,
+			.z = z,
+			.ofmt = ofmt,
+			.sed_mode_p = argi->sed_mode_flag,
+			.empty_mode_p = argi->empty_mode_flag,
+			.quietp = argi->quiet_flag,
+			.fld = fld,
+		};
+		/* in exact mode lines must be date/times in their entirety */
+		const bool exactp =
+			!argi->sed_mode_flag && argi->empty_mode_flag;
+		int njob;
+
+		if ((njob = dt_io_par_njob(argi->jobs_arg)) < 0) {
+			error("Error: cannot parse number of jobs `%s'",
+			      argi->jobs_arg);
+			rc = 1;
+			goto clear;
+		}
 
-		/* no threads reading this stream */
+		/* no threads writing to this stream */
 		__io_setlocking_bycaller(stdout);
 
-		/* lest we overflow the stack */
-		if (nfmt >= nneedle) {
-			/* round to the nearest 8-multiple */
-			nneedle = (nfmt | 7) + 1;
-			needle = calloc(nneedle, sizeof(*needle));
+		if (!exactp) {
+			/* lest we overflow the stack */
+			if (nfmt >= nneedle) {
+				/* round to the nearest 8-multiple */
+				nneedle = (nfmt | 7) + 1;
+				needle = calloc(nneedle, sizeof(*needle));
+			}
+			/* and now build the needle */
+			ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
 		}
-		/* and now build the needle */
-		ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
+		dt_io_prep(fmt, nfmt, ofmt);
 
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("could not open stdin");
-			goto ndl_free;
-		}
+		/* njob can be large, keep the closures off the stack */
+		struct mass_add_clo_s *clo = calloc(njob, sizeof(*clo));
+		void **cp = calloc(njob, sizeof(*cp));
+		int r;
 
-		/* build the clo and then loop */
-		clo->pctx = pctx;
-		clo->gra = &ndlsoa;
-		clo->st = st;
-		clo->fromz = fromz;
-		clo->hackz = hackz;
-		clo->z = z;
-		clo->ofmt = ofmt;
-		clo->sed_mode_p = argi->sed_mode_flag;
-		clo->empty_mode_p = argi->empty_mode_flag;
-		clo->quietp = argi->quiet_flag;
-		while (prchunk_fill(pctx) >= 0) {
-			rc |= mass_add_dur(clo);
+		if (UNLIKELY(clo == NULL || cp == NULL)) {
+			serror("cannot allocate job closures");
+			rc = 1;
+		} else {
+			for (int i = 0; i < njob; i++) {
+				clo[i] = proto;
+				cp[i] = clo + i;
+			}
+			r = dt_io_par(
+				STDIN_FILENO,
+				exactp ? proc_exact : proc_line, cp, njob);
+			if (r < 0) {
+				serror("could not open stdin");
+				rc = 1;
+			} else {
+				rc |= r;
+			}
 		}
-		/* get rid of resources */
-		free_prchunk(pctx);
-	ndl_free:
+		free(clo);
+		free(cp);
 		if (needle != __nstk) {
 			free(needle);
 		}
@@ -437,7 +484,7 @@ Error: cannot interpret date/time string `%s'", inp);
 		__io_setlocking_bycaller(stdout);
 
 		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
+		if ((pctx = init_prchunk_ro(STDIN_FILENO)) == NULL) {
 			serror("could not open stdin");
 			goto clear;
 		}
@@ -452,6 +499,7 @@ Error: cannot interpret date/time string `%s'", inp);
 		clo->sed_mode_p = argi->sed_mode_flag;
 		clo->empty_mode_p = argi->empty_mode_flag;
 		clo->quietp = argi->quiet_flag;
+		clo->fld = fld;
 		while (prchunk_fill(pctx) >= 0) {
 			rc |= mass_add_d(clo);
 		}
@@ -462,7 +510,11 @@ clear:
 	/* free the strpdur status */
 	__strpdtdur_free(&st);
 
+	if (argi->stats_flag) {
+		dt_io_fmtstats(stderr);
+	}
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
@@ -46,58 +46,76 @@
 #include "dt-core.h"
 #include "dt-io.h"
 #include "dt-locale.h"
-#include "prchunk.h"
+#include "dt-io-par.h"
 
 
 const char *prog = "dconv";
 
 struct prln_ctx_s {
 	struct grep_atom_soa_s *ndl;
+	char *const *fmt;
+	size_t nfmt;
 	const char *ofmt;
 	zif_t fromz;
 	zif_t outz;
 	int sed_mode_p;
 	int empty_mode_p;
 	int quietp;
+	struct dt_io_fld_s fld;
 };
 
 static int
-proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
+proc_line(void *clo, FILE *out, char *line, size_t llen)
 {
+	const struct prln_ctx_s ctx = *(const struct prln_ctx_s*)clo;
 	struct dt_dt_s d;
 	char *sp = NULL;
 	char *ep = NULL;
 	size_t nmatch = 0U;
 	int rc = 0;
+	/* the bit of the line we scan, all of it or just one field */
+	char *fp = line;
+	size_t flen = llen;
+	char fc = '\0';
 
+	if (ctx.fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, ctx.fld);
+		/* \0-terminate the field for the parsers, undone below */
+		fc = fp[flen];
+		fp[flen] = '\0';
+	}
 	do {
 		d = dt_io_find_strpdt2(
-			line, llen, ctx.ndl, &sp, &ep, ctx.fromz);
+			fp, flen, ctx.ndl, &sp, &ep, ctx.fromz);
 
 		/* check if line matches */
 		if (!dt_unk_p(d) && ctx.sed_mode_p) {
-			__io_write(line, sp - line, stdout);
-			dt_io_write(d, ctx.ofmt, ctx.outz, '\0');
+			__io_write(line, sp - line, out);
+			dt_io_fwrite(d, ctx.ofmt, ctx.outz, '\0', out);
+			flen -= (ep - fp);
 			llen -= (ep - line);
-			line = ep;
+			fp = line = ep;
 			nmatch++;
 		} else if (!dt_unk_p(d)) {
 			if (UNLIKELY(d.fix) && !ctx.quietp) {
 				rc = 2;
 			}
-			dt_io_write(d, ctx.ofmt, ctx.outz, '\n');
+			dt_io_fwrite(d, ctx.ofmt, ctx.outz, '\n', out);
 			break;
 		} else if (ctx.sed_mode_p) {
+			/* put the field delimiter back */
+			fp[flen] = fc;
 			llen = !(ctx.empty_mode_p && !nmatch) ? llen : 0U;
 			line[llen] = '\n';
-			__io_write(line, llen + 1, stdout);
+			__io_write(line, llen + 1, out);
 			break;
 		} else if (ctx.empty_mode_p) {
-			__io_write("\n", 1U, stdout);
+			__io_write("\n", 1U, out);
 			break;
 		} else {
 			/* obviously unmatched, warn about it in non -q mode */
 			if (!ctx.quietp) {
+				fp[flen] = fc;
 				dt_io_warn_strpdt(line);
 				rc = 2;
 			}
@@ -107,6 +125,35 @@ proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
 	return rc;
 }
 
+static int
+proc_exact(void *clo, FILE *out, char *line, size_t llen)
+{
+/* lines (or fields) must be a date/time in their entirety */
+	const struct prln_ctx_s *ctx = clo;
+	struct dt_dt_s d;
+	char *ep = NULL;
+
+	if (ctx->fld.fld) {
+		llen = dt_io_getfld(&line, line, llen, ctx->fld);
+		line[llen] = '\0';
+	}
+	if (UNLIKELY(!llen)) {
+		goto empty;
+	}
+	/* try and parse the line */
+	d = dt_io_strpdt_ep(line, ctx->fmt, ctx->nfmt, &ep, ctx->fromz);
+	if (UNLIKELY(dt_unk_p(d))) {
+		goto empty;
+	} else if (ep && (unsigned)*ep >= ' ') {
+		goto empty;
+	}
+	dt_io_fwrite(d, ctx->ofmt, ctx->outz, '\n', out);
+	return 0;
+empty:
+	__io_write("\n", 1U, out);
+	return 0;
+}
+
 
 #include "dconv.yucc"
 
@@ -120,6 +167,7 @@ main(int argc, char *argv[])
 	int rc = 0;
 	zif_t fromz = NULL;
 	zif_t z = NULL;
+	struct dt_io_fld_s fld;
 
 	if (yuck_parse(argi, argc, argv)) {
 		rc = 1;
@@ -136,6 +184,11 @@ main(int argc, char *argv[])
 		}
 	}
 
+	if (dt_io_fld(&fld, argi->field_arg, argi->delimiter_arg) < 0) {
+		rc = 1;
+		goto clear;
+	}
+
 	if (argi->locale_arg) {
 		setflocale(argi->locale_arg);
 	}
@@ -143,6 +196,10 @@ main(int argc, char *argv[])
 		setilocale(argi->from_locale_arg);
 	}
 
+	if (argi->stats_flag) {
+		dt_io_fmtstats_on();
+	}
+
 	/* try and read the from and to time zones */
 	if (argi->from_zone_arg &&
 	    (fromz = dt_io_zone(argi->from_zone_arg)) == NULL) {
@@ -178,94 +235,86 @@ Error: cannot find zone specified in --zone: `%s'", argi->zone_arg);
 				dt_io_warn_strpdt(inp);
 			}
 		}
-	} else if (!argi->sed_mode_flag && argi->empty_mode_flag) {
-		/* read from stdin */
-		size_t lno = 0;
-		void *pctx;
-
-		/* no threads reading this stream */
-		__io_setlocking_bycaller(stdout);
-
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("Error: could not open stdin");
-			goto clear;
-		}
-		while (prchunk_fill(pctx) >= 0) {
-			for (char *line; prchunk_haslinep(pctx); lno++) {
-				size_t llen = prchunk_getline(pctx, &line);
-				struct dt_dt_s d;
-				char *ep = NULL;
-
-				if (UNLIKELY(!llen)) {
-					goto empty;
-				}
-				/* try and parse the line */
-				d = dt_io_strpdt_ep(line, fmt, nfmt, &ep, fromz);
-				if (UNLIKELY(dt_unk_p(d))) {
-					goto empty;
-				} else if (ep && (unsigned)*ep >= ' ') {
-					goto empty;
-				}
-				dt_io_write(d, ofmt, z, '\n');
-				continue;
-			empty:
-				__io_write("\n", 1U, stdout);
-			}
-		}
-		/* get rid of resources */
-		free_prchunk(pctx);
 	} else {
 		/* read from stdin */
-		size_t lno = 0;
 		struct grep_atom_s __nstk[16], *needle = __nstk;
 		size_t nneedle = countof(__nstk);
 		struct grep_atom_soa_s ndlsoa;
-		void *pctx;
 		struct prln_ctx_s prln = {
 			.ndl = &ndlsoa,
+			.fmt = fmt,
+			.nfmt = nfmt,
 			.ofmt = ofmt,
 			.fromz = fromz,
 			.outz = z,
 			.sed_mode_p = argi->sed_mode_flag,
 			.empty_mode_p = argi->empty_mode_flag,
 			.quietp = argi->quiet_flag,
+			.fld = fld,
 		};
+		/* in exact mode lines must be date/times in their entirety */
+		const bool exactp =
+			!argi->sed_mode_flag && argi->empty_mode_flag;
+		int njob;
 
-		/* no threads reading this stream */
+		if ((njob = dt_io_par_njob(argi->jobs_arg)) < 0) {
+			error("Error: cannot parse number of jobs `%s'",
+			      argi->jobs_arg);
+			rc = 1;
+			goto clear;
+		}
+
+		/* no threads writing to this stream */
 		__io_setlocking_bycaller(stdout);
 
-		/* lest we overflow the stack */
-		if (nfmt >= nneedle) {
-			/* round to the nearest 8-multiple */
-			nneedle = (nfmt | 7) + 1;
-			needle = calloc(nneedle, sizeof(*needle));
+		if (!exactp) {
+			/* lest we overflow the stack */
+			if (nfmt >= nneedle) {
+				/* round to the nearest 8-multiple */
+				nneedle = (nfmt | 7) + 1;
+				needle = calloc(nneedle, sizeof(*needle));
+			}
+			/* and now build the needles */
+			ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
 		}
-		/* and now build the needles */
-		ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
+		dt_io_prep(fmt, nfmt, ofmt);
 
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("Error: could not open stdin");
-			goto ndl_free;
-		}
-		while (prchunk_fill(pctx) >= 0) {
-			for (char *line; prchunk_haslinep(pctx); lno++) {
-				size_t llen = prchunk_getline(pctx, &line);
+		/* njob can be large, keep the closures off the stack */
+		struct prln_ctx_s *clo = calloc(njob, sizeof(*clo));
+		void **cp = calloc(njob, sizeof(*cp));
+		int r;
 
-				rc |= proc_line(prln, line, llen);
+		if (UNLIKELY(clo == NULL || cp == NULL)) {
+			serror("Error: cannot allocate job closures");
+			rc = 1;
+		} else {
+			for (int i = 0; i < njob; i++) {
+				clo[i] = prln;
+				cp[i] = clo + i;
+			}
+			r = dt_io_par(
+				STDIN_FILENO,
+				exactp ? proc_exact : proc_line, cp, njob);
+			if (r < 0) {
+				serror("Error: could not open stdin");
+				rc = 1;
+			} else {
+				rc |= r;
 			}
 		}
-		/* get rid of resources */
-		free_prchunk(pctx);
-	ndl_free:
+		free(clo);
+		free(cp);
 		if (needle != __nstk) {
 			free(needle);
 		}
 	}
 
 clear:
+	if (argi->stats_flag) {
+		dt_io_fmtstats(stderr);
+	}
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
@@ -674,6 +674,10 @@ main(int argc, char *argv[])
 		setilocale(argi->from_locale_arg);
 	}
 
+	if (argi->stats_flag) {
+		dt_io_fmtstats_on();
+	}
+
 	/* try and read the from and to time zones */
 	if (argi->from_zone_arg &&
 	    (fromz = dt_io_zone(argi->from_zone_arg)) == NULL) {
@@ -796,7 +800,11 @@ Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
 	}
 
 clear:
+	if (argi->stats_flag) {
+		dt_io_fmtstats(stderr);
+	}
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
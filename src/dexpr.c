@@ -2,9 +2,11 @@
 # include "config.h"
 #endif	/* HAVE_CONFIG_H */
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include "nifty.h"
 #include "strops.h"
 #include "dt-locale.h"
 #include "dexpr.h"
@@ -638,6 +640,578 @@ dexpr_matches_p(const_dexpr_t dex, struct dt_dt_s d)
 	return __disj_matches_p(dex, d);
 }
 
+
+static int
+dexkv_bound(const_dexkv_t dkv, struct dt_dt_s d)
+{
+/* return -1 if D is too old to match DKV, 1 if D is too new to match DKV
+ * and 0 otherwise, or if DKV isn't monotonic on the time line */
+	signed int cmp;
+
+	if (dkv->sp.spfl != DT_SPFL_N_STD) {
+		/* %a=Wed and friends come round again and again */
+		return 0;
+	} else if (dt_sandwich_only_t_p(dkv->d)) {
+		/* so do times of day */
+		return 0;
+	} else if ((cmp = __cmp(d, dkv->d)) == -2) {
+		return 0;
+	}
+	switch (dkv->op) {
+	case OP_UNK:
+	case OP_EQ:
+		return cmp;
+	case OP_LT:
+		return cmp >= 0;
+	case OP_LE:
+		return cmp > 0;
+	case OP_GT:
+		return -(cmp <= 0);
+	case OP_GE:
+		return -(cmp < 0);
+	default:
+		break;
+	}
+	return 0;
+}
+
+static bool
+__conj_bound_p(const_dexpr_t dex, struct dt_dt_s d, int dir)
+{
+	const_dexpr_t a;
+
+	for (a = dex; a->type == DEX_CONJ; a = a->right) {
+		if (dexkv_bound(a->left->kv, d) == dir) {
+			return true;
+		}
+	}
+	/* rightmost cell might be a DEX_VAL */
+	return dexkv_bound(a->kv, d) == dir;
+}
+
+static bool
+__disj_bound_p(const_dexpr_t dex, struct dt_dt_s d, int dir)
+{
+	const_dexpr_t o;
+
+	for (o = dex; o->type == DEX_DISJ; o = o->right) {
+		if (!__conj_bound_p(o->left, d, dir)) {
+			return false;
+		}
+	}
+	/* rightmost cell may be a DEX_VAL */
+	return __conj_bound_p(o, d, dir);
+}
+
+static __attribute__((unused)) bool
+dexpr_before_p(const_dexpr_t dex, struct dt_dt_s d)
+{
+/* return true if neither D nor anything older than D can match DEX,
+ * DEX must be in normal form, see dexpr_simplify() */
+	return __disj_bound_p(dex, d, -1);
+}
+
+static __attribute__((unused)) bool
+dexpr_beyond_p(const_dexpr_t dex, struct dt_dt_s d)
+{
+/* return true if neither D nor anything newer than D can match DEX,
+ * DEX must be in normal form, see dexpr_simplify() */
+	return __disj_bound_p(dex, d, 1);
+}
+
+static bool
+dexkv_ceil_p(const_dexkv_t dkv)
+{
+/* return true if DKV can rule out everything newer than some date/time */
+	if (dkv->sp.spfl != DT_SPFL_N_STD) {
+		return false;
+	} else if (dt_sandwich_only_t_p(dkv->d)) {
+		return false;
+	}
+	switch (dkv->op) {
+	case OP_UNK:
+	case OP_EQ:
+	case OP_LT:
+	case OP_LE:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+static bool
+__conj_ceil_p(const_dexpr_t dex)
+{
+	const_dexpr_t a;
+
+	for (a = dex; a->type == DEX_CONJ; a = a->right) {
+		if (dexkv_ceil_p(a->left->kv)) {
+			return true;
+		}
+	}
+	/* rightmost cell might be a DEX_VAL */
+	return dexkv_ceil_p(a->kv);
+}
+
+static __attribute__((unused)) bool
+dexpr_ceil_p(const_dexpr_t dex)
+{
+/* return false if dexpr_beyond_p() is false for any D,
+ * DEX must be in normal form, see dexpr_simplify() */
+	const_dexpr_t o;
+
+	for (o = dex; o->type == DEX_DISJ; o = o->right) {
+		if (!__conj_ceil_p(o->left)) {
+			return false;
+		}
+	}
+	/* rightmost cell may be a DEX_VAL */
+	return __conj_ceil_p(o);
+}
+
+
+/* compiled dexprs
+ * Comparisons against full dates and date/times turn into sets of
+ * intervals over a key that orders like dt_dtcmp() does, comparisons
+ * against times of day into intervals over the time slot as compared
+ * by dt_tcmp(), and field predicates (%Y, %m, %d, %w, %j) into
+ * bitmasks of admissible values. */
+#define DEXC_KEY_TSZ	(24U)
+#define DEXC_KEY_MAX	(UINT64_MAX)
+
+/* inclusive on both ends so the whole domain can be represented */
+struct dexiv_s {
+	uint64_t lo;
+	uint64_t hi;
+};
+
+struct dexset_s {
+	size_t niv;
+	struct dexiv_s *iv;
+};
+
+typedef enum {
+	DEXC_DT = 0x01U,
+	DEXC_T = 0x02U,
+	DEXC_YEAR = 0x04U,
+	DEXC_MON = 0x08U,
+	DEXC_MDAY = 0x10U,
+	DEXC_WDAY = 0x20U,
+	DEXC_YDAY = 0x40U,
+} dexc_fld_t;
+
+struct dexcl_s {
+	/* bitwise or of dexc_fld_t, the predicates to check */
+	unsigned int flds;
+	/* date/time keys, see __dexc_key() */
+	struct dexset_s dt;
+	/* time slots of t-only comparisons */
+	struct dexset_s t;
+	/* bit V is set iff value V is admissible */
+	uint64_t year[4096U / 64U];
+	uint64_t yday[512U / 64U];
+	uint64_t mday;
+	uint16_t mon;
+	uint16_t wday;
+};
+
+struct dexc_s {
+	/* union of all date/time key sets if there are no other predicates */
+	struct dexset_s all;
+	size_t ncl;
+	struct dexcl_s cl[];
+};
+
+static inline bool
+__dexc_keyable_p(struct dt_d_s d)
+{
+	/* ymds, with the spare bits unset so the key can be 64 bits */
+	return d.typ == DT_YMD && d.ymd.u < (1U << 22U);
+}
+
+static inline uint64_t
+__dexc_key(struct dt_dt_s d)
+{
+/* dt_dtcmp() compares the date slot, then the time slot */
+	return (uint64_t)d.d.ymd.u << DEXC_KEY_TSZ ^ d.t.hms.u24;
+}
+
+static bool
+__dexset_has_p(const struct dexset_s *s, uint64_t k)
+{
+	size_t lo = 0U;
+	size_t hi = s->niv;
+
+	/* find the first interval with an upper bound at or beyond K */
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2U;
+
+		if (s->iv[mid].hi < k) {
+			lo = mid + 1U;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo < s->niv && s->iv[lo].lo <= k;
+}
+
+static size_t
+__dexiv_op(struct dexiv_s tgt[static 2U], oper_t op, uint64_t lo, uint64_t hi)
+{
+/* put the set of keys x such that x OP [LO, HI] holds into TGT,
+ * where [LO, HI] is the set of keys comparing equal to the cell,
+ * return the number of intervals */
+	size_t n = 0U;
+
+	switch (op) {
+	case OP_UNK:
+	case OP_EQ:
+		tgt[n++] = (struct dexiv_s){lo, hi};
+		break;
+	case OP_LT:
+	case OP_NE:
+		if (lo > 0U) {
+			tgt[n++] = (struct dexiv_s){0U, lo - 1U};
+		}
+		if (op == OP_LT || hi == DEXC_KEY_MAX) {
+			break;
+		}
+		/*@fallthrough@*/
+	case OP_GT:
+		if (hi < DEXC_KEY_MAX) {
+			tgt[n++] = (struct dexiv_s){hi + 1U, DEXC_KEY_MAX};
+		}
+		break;
+	case OP_LE:
+		tgt[n++] = (struct dexiv_s){0U, hi};
+		break;
+	case OP_GE:
+		tgt[n++] = (struct dexiv_s){lo, DEXC_KEY_MAX};
+		break;
+	case OP_TRUE:
+		tgt[n++] = (struct dexiv_s){0U, DEXC_KEY_MAX};
+		break;
+	default:
+		break;
+	}
+	return n;
+}
+
+static int
+__dexset_and(struct dexset_s *s, const struct dexiv_s *iv, size_t niv)
+{
+/* intersect S with the sorted intervals IV */
+	struct dexiv_s *res;
+	size_t n = 0U;
+
+	if (UNLIKELY((res = malloc((s->niv + niv) * sizeof(*res))) == NULL)) {
+		return -1;
+	}
+	for (size_t i = 0U, j = 0U; i < s->niv && j < niv;) {
+		uint64_t lo = s->iv[i].lo > iv[j].lo ? s->iv[i].lo : iv[j].lo;
+		uint64_t hi = s->iv[i].hi < iv[j].hi ? s->iv[i].hi : iv[j].hi;
+
+		if (lo <= hi) {
+			res[n++] = (struct dexiv_s){lo, hi};
+		}
+		/* advance whichever ends first */
+		if (s->iv[i].hi < iv[j].hi) {
+			i++;
+		} else {
+			j++;
+		}
+	}
+	free(s->iv);
+	s->iv = res;
+	s->niv = n;
+	return 0;
+}
+
+static bool
+__dexc_fld_p(oper_t op, signed int s, signed int v)
+{
+/* like the field branch of dexkv_matches_p() */
+	switch (op) {
+	case OP_EQ:
+		return s == v;
+	case OP_LT:
+		return s < v;
+	case OP_LE:
+		return s <= v;
+	case OP_GT:
+		return s > v;
+	case OP_GE:
+		return s >= v;
+	case OP_NE:
+		return s != v;
+	case OP_TRUE:
+		return true;
+	default:
+		break;
+	}
+	return false;
+}
+
+static int
+__dexcl_kv(struct dexcl_s *cl, const_dexkv_t kv)
+{
+/* narrow down clause CL by KV, return -1 if KV cannot be compiled */
+	struct dexiv_s iv[2U];
+	struct dt_dt_s c = kv->d;
+
+	switch (kv->sp.spfl) {
+	case DT_SPFL_N_STD:
+		if (dt_sandwich_only_t_p(c)) {
+			/* dt_tcmp() compares the whole slot */
+			size_t n = __dexiv_op(iv, kv->op, c.t.u, c.t.u);
+
+			cl->flds |= DEXC_T;
+			return __dexset_and(&cl->t, iv, n);
+		} else if (!__dexc_keyable_p(c.d)) {
+			break;
+		} else if (dt_sandwich_only_d_p(c)) {
+			/* dt_dcmp() ignores the time slot */
+			uint64_t lo = (uint64_t)c.d.ymd.u << DEXC_KEY_TSZ;
+			uint64_t hi = lo ^ ((1U << DEXC_KEY_TSZ) - 1U);
+			size_t n = __dexiv_op(iv, kv->op, lo, hi);
+
+			cl->flds |= DEXC_DT;
+			return __dexset_and(&cl->dt, iv, n);
+		} else if (dt_sandwich_p(c) && !c.t.hms.ns) {
+			uint64_t k = __dexc_key(c);
+			size_t n = __dexiv_op(iv, kv->op, k, k);
+
+			cl->flds |= DEXC_DT;
+			return __dexset_and(&cl->dt, iv, n);
+		}
+		break;
+
+	case DT_SPFL_N_YEAR:
+		for (signed int v = 0; v < 4096; v++) {
+			if (!__dexc_fld_p(kv->op, kv->s, v)) {
+				cl->year[v / 64] &= ~(1ULL << (v % 64));
+			}
+		}
+		cl->flds |= DEXC_YEAR;
+		return 0;
+	case DT_SPFL_N_MON:
+	case DT_SPFL_S_MON:
+		for (signed int v = 0; v < 16; v++) {
+			if (!__dexc_fld_p(kv->op, kv->s, v)) {
+				cl->mon &= ~(1U << v);
+			}
+		}
+		cl->flds |= DEXC_MON;
+		return 0;
+	case DT_SPFL_N_DCNT_MON:
+		for (signed int v = 0; v < 64; v++) {
+			if (!__dexc_fld_p(kv->op, kv->s, v)) {
+				cl->mday &= ~(1ULL << v);
+			}
+		}
+		cl->flds |= DEXC_MDAY;
+		return 0;
+	case DT_SPFL_N_DCNT_WEEK:
+	case DT_SPFL_S_WDAY:
+		for (signed int v = 0; v < 16; v++) {
+			if (!__dexc_fld_p(kv->op, kv->s, v)) {
+				cl->wday &= ~(1U << v);
+			}
+		}
+		cl->flds |= DEXC_WDAY;
+		return 0;
+	case DT_SPFL_N_DCNT_YEAR:
+		for (signed int v = 0; v < 512; v++) {
+			if (!__dexc_fld_p(kv->op, kv->s, v)) {
+				cl->yday[v / 64] &= ~(1ULL << (v % 64));
+			}
+		}
+		cl->flds |= DEXC_YDAY;
+		return 0;
+	default:
+		/* week counts and whatnot */
+		break;
+	}
+	return -1;
+}
+
+static int
+__dexcl(struct dexcl_s *cl, const_dexpr_t dex)
+{
+/* compile the conjunction DEX into CL, cf. __conj_matches_p() */
+	const_dexpr_t a;
+
+	*cl = (struct dexcl_s){0U};
+	memset(cl->year, -1, sizeof(cl->year));
+	memset(cl->yday, -1, sizeof(cl->yday));
+	cl->mday = ~0ULL;
+	cl->mon = cl->wday = 0xffffU;
+	if ((cl->dt.iv = malloc(sizeof(*cl->dt.iv))) == NULL ||
+	    (cl->t.iv = malloc(sizeof(*cl->t.iv))) == NULL) {
+		return -1;
+	}
+	cl->dt.iv[0U] = cl->t.iv[0U] = (struct dexiv_s){0U, DEXC_KEY_MAX};
+	cl->dt.niv = cl->t.niv = 1U;
+
+	for (a = dex; a->type == DEX_CONJ; a = a->right) {
+		if (__dexcl_kv(cl, a->left->kv) < 0) {
+			return -1;
+		}
+	}
+	/* rightmost cell might be a DEX_VAL */
+	return __dexcl_kv(cl, a->kv);
+}
+
+static int
+__dexiv_cmp(const void *x, const void *y)
+{
+	const struct dexiv_s *a = x;
+	const struct dexiv_s *b = y;
+
+	return (a->lo > b->lo) - (a->lo < b->lo);
+}
+
+static void
+free_dexc(dexc_t c)
+{
+	for (size_t i = 0U; i < c->ncl; i++) {
+		free(c->cl[i].dt.iv);
+		free(c->cl[i].t.iv);
+	}
+	free(c->all.iv);
+	free(c);
+	return;
+}
+
+static __attribute__((unused)) dexc_t
+dexpr_compile(const_dexpr_t root)
+{
+/* compile ROOT, which must be in normal form (see dexpr_simplify()),
+ * return NULL if ROOT has predicates that cannot be compiled */
+	const_dexpr_t o;
+	size_t ncl = 1U;
+	size_t nall = 0U;
+	bool allp = true;
+	dexc_t res;
+
+	for (o = root; o->type == DEX_DISJ; o = o->right, ncl++);
+	if ((res = calloc(1, sizeof(*res) + ncl * sizeof(*res->cl))) == NULL) {
+		return NULL;
+	}
+	o = root;
+	for (size_t i = 0U; i < ncl; i++, o = o->right) {
+		res->ncl++;
+		if (__dexcl(res->cl + i, o->type == DEX_DISJ ? o->left : o) < 0) {
+			goto nope;
+		}
+		allp &= !(res->cl[i].flds & ~DEXC_DT);
+		nall += res->cl[i].dt.niv;
+	}
+	if (!allp) {
+		/* clauses will be checked one by one */
+		return res;
+	}
+	/* just the one interval set then */
+	if ((res->all.iv = malloc((nall + 1U) * sizeof(*res->all.iv))) == NULL) {
+		goto nope;
+	}
+	for (size_t i = 0U; i < ncl; i++) {
+		memcpy(res->all.iv + res->all.niv, res->cl[i].dt.iv,
+		       res->cl[i].dt.niv * sizeof(*res->all.iv));
+		res->all.niv += res->cl[i].dt.niv;
+	}
+	qsort(res->all.iv, res->all.niv, sizeof(*res->all.iv), __dexiv_cmp);
+	/* merge overlaps */
+	nall = 0U;
+	for (size_t i = 0U; i < res->all.niv; i++) {
+		struct dexiv_s *last = res->all.iv + nall - 1U;
+
+		if (nall && (last->hi == DEXC_KEY_MAX ||
+			     res->all.iv[i].lo <= last->hi + 1U)) {
+			if (res->all.iv[i].hi > last->hi) {
+				last->hi = res->all.iv[i].hi;
+			}
+			continue;
+		}
+		res->all.iv[nall++] = res->all.iv[i];
+	}
+	res->all.niv = nall;
+	/* the clauses are no longer needed */
+	for (size_t i = 0U; i < ncl; i++) {
+		free(res->cl[i].dt.iv);
+		free(res->cl[i].t.iv);
+	}
+	res->ncl = 0U;
+	return res;
+nope:
+	free_dexc(res);
+	return NULL;
+}
+
+static int
+__dexc_matches(const_dexc_t c, struct dt_dt_s d)
+{
+/* return 1 if D matches C, 0 if it doesn't and -1 if D has no key */
+	uint64_t k;
+
+	if (UNLIKELY(!__dexc_keyable_p(d.d) || d.t.hms.ns)) {
+		return -1;
+	}
+	k = __dexc_key(d);
+	if (!c->ncl) {
+		return __dexset_has_p(&c->all, k);
+	}
+	for (size_t i = 0U; i < c->ncl; i++) {
+		const struct dexcl_s *cl = c->cl + i;
+		unsigned int v;
+
+		if ((cl->flds & DEXC_DT) && !__dexset_has_p(&cl->dt, k)) {
+			continue;
+		} else if ((cl->flds & DEXC_T) &&
+			   !__dexset_has_p(&cl->t, d.t.u)) {
+			continue;
+		} else if ((cl->flds & DEXC_YEAR) &&
+			   !(cl->year[d.d.ymd.y / 64U] >> d.d.ymd.y % 64U & 1U)) {
+			continue;
+		} else if ((cl->flds & DEXC_MON) &&
+			   !(cl->mon >> d.d.ymd.m & 1U)) {
+			continue;
+		} else if ((cl->flds & DEXC_MDAY) &&
+			   !(cl->mday >> d.d.ymd.d & 1U)) {
+			continue;
+		}
+		if (cl->flds & DEXC_WDAY) {
+			if (UNLIKELY((v = dt_get_wday(d.d)) >= 16U)) {
+				return -1;
+			} else if (!(cl->wday >> v & 1U)) {
+				continue;
+			}
+		}
+		if (cl->flds & DEXC_YDAY) {
+			if (UNLIKELY((v = dt_get_yday(d.d)) >= 512U)) {
+				return -1;
+			} else if (!(cl->yday[v / 64U] >> (v % 64U) & 1U)) {
+				continue;
+			}
+		}
+		return 1;
+	}
+	return 0;
+}
+
+static __attribute__((unused)) bool
+dexc_matches_p(const_dexc_t c, const_dexpr_t dex, struct dt_dt_s d)
+{
+/* like dexpr_matches_p() but use DEX's compiled form C where possible */
+	int res;
+
+	if (c != NULL && (res = __dexc_matches(c, d)) >= 0) {
+		return res;
+	}
+	return dexpr_matches_p(dex, d);
+}
+
 
 #if defined STANDALONE
 const char *prog = "dexpr";
@@ -11,6 +11,10 @@ typedef const struct dexpr_s *const_dexpr_t;
 typedef struct dexkv_s *dexkv_t;
 typedef const struct dexkv_s *const_dexkv_t;
 
+/* compiled form of a dexpr */
+typedef struct dexc_s *dexc_t;
+typedef const struct dexc_s *const_dexc_t;
+
 typedef enum {
 	DEX_UNK,
 	DEX_VAL,
@@ -40,6 +40,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
 
@@ -48,6 +51,8 @@
 #include "dt-io.h"
 #include "dexpr.h"
 #include "dt-locale.h"
+#include "dt-io-par.h"
+#include "dt-io-idx.h"
 #include "prchunk.h"
 
 const char *prog = "dgrep";
@@ -59,21 +64,35 @@ const char *prog = "dgrep";
 struct prln_ctx_s {
 	struct grep_atom_soa_s *ndl;
 	dexpr_t root;
+	const_dexc_t dexc;
 	zif_t fromz;
 	zif_t z;
 	unsigned int only_matching_p:1U;
 	unsigned int invert_match_p:1U;
+	struct dt_io_fld_s fld;
 };
 
-static void
-proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
+static int
+proc_line(void *clo, FILE *out, char *line, size_t llen)
 {
+	const struct prln_ctx_s ctx = *(const struct prln_ctx_s*)clo;
 	char *osp = NULL;
 	char *oep = NULL;
+	/* the bit of the line we scan, all of it or just one field */
+	char *fp = line;
+	size_t flen = llen;
+	char fc = '\0';
+
+	if (ctx.fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, ctx.fld);
+		/* \0-terminate the field for the parsers, undone below */
+		fc = fp[flen];
+		fp[flen] = '\0';
+	}
 
 	/* check if line matches,
 	 * there's currently no way to specify NEEDLE */
-	for (char *lp = line, *const zp = line + llen, *sp, *ep;
+	for (char *lp = fp, *const zp = fp + flen, *sp, *ep;
 	     /*no check*/; lp = ep, osp = sp, oep = ep) {
 		struct dt_dt_s d =
 			dt_io_find_strpdt2(
@@ -88,35 +107,278 @@ proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
 			d = dtz_enrichz(d, ctx.z);
 		}
 		/* otherwise */
-		if (dexpr_matches_p(ctx.root, d)) {
+		if (dexc_matches_p(ctx.dexc, ctx.root, d)) {
 			if (ctx.invert_match_p) {
 				/* nothing must match */
-				return;
+				return 0;
 			} else if (!ctx.only_matching_p) {
+				fp[flen] = fc;
 				sp = line;
 				ep = line + llen;
 			}
 			/* make sure we finish the line */
 			*ep++ = '\n';
-			__io_write(sp, ep - sp, stdout);
-			return;
+			__io_write(sp, ep - sp, out);
+			return 0;
 		}
 	}
 	if (ctx.invert_match_p) {
 		/* no match but invert_match select, print line */
 		if (!ctx.only_matching_p) {
+			fp[flen] = fc;
 			osp = line;
 			oep = line + llen;
 		} else if (osp == NULL || oep == NULL) {
 			/* no date in line and only-matching is active
 			 * bugger off */
-			return;
+			return 0;
 		}
 		/* finish the line and bugger off */
 		*oep++ = '\n';
-		__io_write(osp, oep - osp, stdout);
+		__io_write(osp, oep - osp, out);
+	}
+	return 0;
+}
+
+
+/* sorted input */
+#define PROBZ	(65536U)
+#define MINZ	(4096U)
+
+static struct dt_dt_s
+line_key(const struct prln_ctx_s ctx[static 1U], char *line, size_t llen)
+{
+/* return the first date/time on LINE, or in the field of interest */
+	char *fp = line;
+	size_t flen = llen;
+	char fc = '\0';
+	char *sp, *ep;
+	struct dt_dt_s d;
+
+	if (ctx->fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, ctx->fld);
+		fc = fp[flen];
+		fp[flen] = '\0';
+	}
+	d = dt_io_find_strpdt2(fp, flen, ctx->ndl, &sp, &ep, ctx->fromz);
+	if (ctx->fld.fld) {
+		fp[flen] = fc;
+	}
+	if (!dt_unk_p(d) && ctx->z != NULL) {
+		/* promote to zone ctx.z */
+		d = dtz_enrichz(d, ctx->z);
+	}
+	return d;
+}
+
+static int
+probe(struct dt_dt_s *restrict key, off_t *restrict eol,
+      int fd, off_t mid, off_t hi, const struct prln_ctx_s ctx[static 1U])
+{
+/* find the first line with a date/time that starts within [MID, HI),
+ * put said date/time into KEY and the offset past the line into EOL,
+ * return 1 if there is such a line, 0 if there's none and -1 if
+ * lines are too long for our buffer to tell */
+	static char buf[PROBZ];
+	/* the line before MID might end right at MID */
+	const off_t o = mid - 1;
+	ssize_t nrd;
+	char *bp, *ep;
+
+	if ((nrd = pread(fd, buf, sizeof(buf) - 1U, o)) <= 0) {
+		return -1;
+	}
+	ep = buf + nrd;
+	/* skip to the first line start at or beyond MID */
+	if ((bp = memchr(buf, '\n', nrd)) == NULL) {
+		return (size_t)nrd < sizeof(buf) - 1U ? 0 : -1;
+	}
+	for (bp++; o + (bp - buf) < hi && bp < ep;) {
+		char *lp = memchr(bp, '\n', ep - bp);
+
+		if (lp == NULL && (size_t)nrd < sizeof(buf) - 1U) {
+			/* last line, unterminated */
+			lp = ep;
+		} else if (lp == NULL) {
+			return -1;
+		}
+		*lp = '\0';
+		*key = line_key(ctx, bp, lp - bp);
+		if (!dt_unk_p(*key)) {
+			*eol = o + (lp - buf) + 1;
+			return 1;
+		}
+		bp = lp + 1;
+	}
+	return 0;
+}
+
+static off_t
+bisect(int fd, off_t lo, off_t hi, const struct prln_ctx_s ctx[static 1U])
+{
+/* return the offset of a line start in [LO, HI) of FD such that all lines
+ * before it are without date/times or too old to match CTX's expression */
+	while (hi - lo > (off_t)MINZ) {
+		const off_t mid = lo + (hi - lo) / 2;
+		struct dt_dt_s key;
+		off_t eol;
+
+		switch (probe(&key, &eol, fd, mid, hi, ctx)) {
+		case 1:
+			if (dexpr_before_p(ctx->root, key)) {
+				/* lines up to and including this one are out */
+				lo = eol;
+				break;
+			}
+			/*@fallthrough@*/
+		case 0:
+			/* everything from MID onwards is too new or dateless */
+			hi = mid;
+			break;
+		default:
+			/* let the linear scan take over */
+			return lo;
+		}
+	}
+	return lo;
+}
+
+static int
+proc_sorted(int fd, struct prln_ctx_s ctx[static 1U])
+{
+/* like dt_io_par() but for chronologically sorted input, if FD is a
+ * regular file skip to the first line that may match, then stop at
+ * the first line that is past the range of CTX's expression */
+	/* without an upper bound there's no early exit, so don't bother
+	 * extracting the keys */
+	const bool ceilp = dexpr_ceil_p(ctx->root);
+	struct stat st;
+	void *pctx;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		off_t o = lseek(fd, 0, SEEK_CUR);
+		off_t lo;
+
+		if (o >= 0 && (lo = bisect(fd, o, st.st_size, ctx)) > o &&
+		    lseek(fd, lo, SEEK_SET) < 0) {
+			return -1;
+		}
+	}
+	if ((pctx = init_prchunk_ro(fd)) == NULL) {
+		return -1;
+	}
+	while (prchunk_fill(pctx) >= 0) {
+		for (char *line; prchunk_haslinep(pctx);) {
+			size_t llen = prchunk_getline_rw(pctx, &line);
+
+			if (UNLIKELY(line == NULL)) {
+				goto out;
+			} else if (ceilp) {
+				struct dt_dt_s key = line_key(ctx, line, llen);
+
+				if (!dt_unk_p(key) &&
+				    dexpr_beyond_p(ctx->root, key)) {
+					/* no more matches from here on */
+					goto out;
+				}
+			}
+			(void)proc_line(ctx, stdout, line, llen);
+		}
+	}
+out:
+	free_prchunk(pctx);
+	return 0;
+}
+
+
+/* indexed input */
+struct rng_s {
+	uint64_t lo;
+	uint64_t hi;
+};
+
+static int
+rng_cmp(const void *a, const void *b)
+{
+	const struct rng_s *x = a, *y = b;
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+static int
+proc_idx_line(void *clo, char *line, size_t llen, off_t UNUSED(off))
+{
+	return proc_line(clo, stdout, line, llen);
+}
+
+static int
+proc_index(int fd, const char *fn, uint64_t sig,
+	   struct prln_ctx_s ctx[static 1U])
+{
+/* like dt_io_par() but only look at the bits of FD that index FN
+ * deems worthy, in file order, FN must have been built with the
+ * settings of signature SIG */
+	const struct dt_idx_hdr_s *hdr;
+	const struct dt_idx_ent_s *e;
+	/* date/times promoted to ctx->z may move by up to a day */
+	int64_t slop = 0;
+	struct rng_s *r;
+	size_t nr = 0U;
+	size_t lo, hi;
+	int rc = 0;
+
+	if ((hdr = dt_idx_open(fn, fd, sig)) == NULL) {
+		return -1;
+	} else if (ctx->z != NULL) {
+		slop = (86400 + hdr->width - 1) / hdr->width;
+	}
+	e = dt_idx_ents(hdr);
+	/* entries are sorted by their first bucket, once that's too new
+	 * so are all the following */
+	for (lo = 0U, hi = hdr->nent; lo < hi;) {
+		size_t mid = (lo + hi) / 2U;
+		struct dt_dt_s d;
+
+		if (e[mid].blo == DT_IDX_NOBKT) {
+			lo = mid + 1U;
+			continue;
+		}
+		d = dt_idx_bkt_dt(e[mid].blo - slop, hdr->width);
+		if (dexpr_beyond_p(ctx->root, d)) {
+			hi = mid;
+		} else {
+			lo = mid + 1U;
+		}
+	}
+	if (UNLIKELY((r = malloc((lo ?: 1U) * sizeof(*r))) == NULL)) {
+		dt_idx_close(hdr);
+		return -1;
+	}
+	for (size_t i = 0U; i < lo; i++) {
+		if (e[i].blo != DT_IDX_NOBKT) {
+			struct dt_dt_s d =
+				dt_idx_bkt_dt(e[i].bhi + 1 + slop, hdr->width);
+
+			if (dexpr_before_p(ctx->root, d)) {
+				/* all too old */
+				continue;
+			}
+		}
+		r[nr++] = (struct rng_s){e[i].lo, e[i].hi};
+	}
+	dt_idx_close(hdr);
+
+	/* and now in file order, merging overlapping ranges */
+	qsort(r, nr, sizeof(*r), rng_cmp);
+	for (size_t i = 0U; i < nr;) {
+		struct rng_s x = r[i];
+
+		for (i++; i < nr && r[i].lo <= x.hi; i++) {
+			x.hi = r[i].hi > x.hi ? r[i].hi : x.hi;
+		}
+		rc |= dt_idx_scan(fd, x.lo, x.hi, proc_idx_line, ctx);
 	}
-	return;
+	free(r);
+	return rc < 0 ? -1 : 0;
 }
 
 
@@ -129,14 +391,19 @@ main(int argc, char *argv[])
 	char **fmt;
 	size_t nfmt;
 	dexpr_t root;
+	dexc_t dexc = NULL;
 	oper_t o = OP_UNK;
 	zif_t fromz = NULL;
 	zif_t z = NULL;
+	struct dt_io_fld_s fld;
 	int rc = 0;
 
 	if (yuck_parse(argi, argc, argv)) {
 		rc = 1;
 		goto out;
+	} else if (dt_io_fld(&fld, argi->field_arg, argi->delimiter_arg) < 0) {
+		rc = 1;
+		goto out;
 	}
 
 	/* init and unescape sequences, maybe */
@@ -204,24 +471,34 @@ Error: cannot find zone specified in --zone: `%s'", argi->zone_arg);
 
 	/* otherwise bring dexpr to normal form */
 	dexpr_simplify(root);
+	/* and try and turn it into something cheaper to evaluate */
+	dexc = dexpr_compile(root);
 	/* beef */
 	{
 		/* read from stdin */
-		size_t lno = 0;
 		struct grep_atom_s __nstk[16], *needle = __nstk;
 		size_t nneedle = countof(__nstk);
 		struct grep_atom_soa_s ndlsoa;
-		void *pctx;
 		struct prln_ctx_s prln = {
 			.ndl = &ndlsoa,
 			.root = root,
+			.dexc = dexc,
 			.fromz = fromz,
 			.z = z,
 			.only_matching_p = argi->only_matching_flag,
 			.invert_match_p = argi->invert_match_flag,
+			.fld = fld,
 		};
+		int njob;
+
+		if ((njob = dt_io_par_njob(argi->jobs_arg)) < 0) {
+			error("Error: cannot parse number of jobs `%s'",
+			      argi->jobs_arg);
+			rc = 1;
+			goto clear;
+		}
 
-		/* no threads reading this stream */
+		/* no threads writing to this stream */
 		__io_setlocking_bycaller(stdout);
 
 		/* lest we overflow the stack */
@@ -232,30 +509,64 @@ Error: cannot find zone specified in --zone: `%s'", argi->zone_arg);
 		}
 		/* and now build the needle */
 		ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
+		dt_io_prep(fmt, nfmt, NULL);
 
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("Error: could not open stdin");
-			goto ndl_free;
-		}
-		while (prchunk_fill(pctx) >= 0) {
-			for (char *line; prchunk_haslinep(pctx); lno++) {
-				size_t llen = prchunk_getline(pctx, &line);
+		if (argi->index_arg && !argi->invert_match_flag) {
+			/* the ranges have to be read in order */
+			const uint64_t sig = dt_idx_sig(
+				argi->from_zone_arg, argi->from_locale_arg,
+				argi->base_arg,
+				argi->field_arg, argi->delimiter_arg,
+				fmt, nfmt);
 
-				proc_line(prln, line, llen);
+			if (proc_index(STDIN_FILENO,
+				       argi->index_arg, sig, &prln) < 0) {
+				serror("\
+Error: cannot use index `%s' with stdin", argi->index_arg);
+				rc = 1;
+			}
+		} else if (argi->sorted_flag && !argi->invert_match_flag) {
+			/* bisection and early exit are inherently serial */
+			if (proc_sorted(STDIN_FILENO, &prln) < 0) {
+				serror("Error: could not open stdin");
+				rc = 1;
 			}
+		} else {
+			/* the expression and the zones are only ever
+			 * read from here on */
+			struct prln_ctx_s *clo = calloc(njob, sizeof(*clo));
+			void **cp = calloc(njob, sizeof(*cp));
+
+			if (UNLIKELY(clo == NULL || cp == NULL)) {
+				serror("Error: cannot allocate job closures");
+				rc = 1;
+			} else {
+				for (int i = 0; i < njob; i++) {
+					clo[i] = prln;
+					cp[i] = clo + i;
+				}
+				if (dt_io_par(
+					    STDIN_FILENO, proc_line,
+					    cp, njob) < 0) {
+					serror("Error: could not open stdin");
+					rc = 1;
+				}
+			}
+			free(clo);
+			free(cp);
 		}
-		/* get rid of resources */
-		free_prchunk(pctx);
-	ndl_free:
 		if (needle != __nstk) {
 			free(needle);
 		}
 	}
 clear:
 	/* resource freeing */
+	if (dexc != NULL) {
+		free_dexc(dexc);
+	}
 	free_dexpr(root);
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
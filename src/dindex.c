@@ -0,0 +1,498 @@
+/*** dindex.c -- build time indices for FILEs
+ *
+ * Copyright (C) 2011-2022 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of dateutils.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if defined HAVE_PTHREAD_H
+# include <pthread.h>
+#endif	/* HAVE_PTHREAD_H */
+
+#include "dt-core.h"
+#include "dt-io.h"
+#include "dt-io-par.h"
+#include "dt-io-idx.h"
+#include "dt-locale.h"
+
+const char *prog = "dindex";
+
+/* lines of one bucket no further apart than this share an entry */
+#define SLACK		(65536U)
+/* neighbouring buckets share entries up to this many bytes */
+#define GRANULE		(262144U)
+/* number of entries a worker keeps extending */
+#define NOPEN		(64U)
+/* number of entries after which a worker compacts its list */
+#define NCOMPACT	(1048576U)
+
+struct prln_ctx_s {
+	struct grep_atom_soa_s *ndl;
+	zif_t fromz;
+	struct dt_io_fld_s fld;
+	unsigned int width;
+	/* signature of the settings above, see dt_idx_sig() */
+	uint64_t sig;
+};
+
+struct ents_s {
+	struct dt_idx_ent_s *e;
+	size_t n;
+	size_t z;
+};
+
+/* a worker indexes the lines starting in [LO, HI) */
+struct widx_s {
+	struct prln_ctx_s ctx;
+	int fd;
+	off_t lo;
+	off_t hi;
+	/* entries still being extended, by bucket hash, HI == 0 if unused */
+	struct dt_idx_ent_s open[NOPEN];
+	struct ents_s ents;
+	size_t ncompact;
+	int rc;
+#if defined HAVE_PTHREAD_H
+	pthread_t thr;
+#endif	/* HAVE_PTHREAD_H */
+};
+
+
+static int
+push_ent(struct ents_s *es, struct dt_idx_ent_s e)
+{
+	if (UNLIKELY(es->n >= es->z)) {
+		size_t nu = es->z ? es->z * 2U : 1024U;
+		struct dt_idx_ent_s *tmp;
+
+		if ((tmp = realloc(es->e, nu * sizeof(*es->e))) == NULL) {
+			return -1;
+		}
+		es->e = tmp;
+		es->z = nu;
+	}
+	es->e[es->n++] = e;
+	return 0;
+}
+
+static int
+ent_cmp(const void *a, const void *b)
+{
+	const struct dt_idx_ent_s *x = a, *y = b;
+
+	if (x->blo != y->blo) {
+		return x->blo < y->blo ? -1 : 1;
+	}
+	return (x->lo > y->lo) - (x->lo < y->lo);
+}
+
+static bool
+mergeable_p(const struct dt_idx_ent_s *x, const struct dt_idx_ent_s *y)
+{
+/* whether Y may be merged into X, X must not be sorted after Y */
+	const uint64_t lo = x->lo < y->lo ? x->lo : y->lo;
+	const uint64_t hi = x->hi > y->hi ? x->hi : y->hi;
+
+	if ((x->blo == DT_IDX_NOBKT) != (y->blo == DT_IDX_NOBKT)) {
+		/* never mix those */
+		return false;
+	} else if (x->blo == x->bhi && y->blo == x->blo && y->bhi == x->bhi) {
+		/* same bucket, only mind the gap */
+		return y->lo <= x->hi + SLACK;
+	}
+	/* neighbouring buckets, mind the span */
+	return y->blo <= x->bhi + 1 && hi - lo <= GRANULE;
+}
+
+static size_t
+coalesce(struct dt_idx_ent_s *e, size_t n)
+{
+/* sort entries E and merge neighbours, return the new number of entries */
+	size_t res = 0U;
+
+	qsort(e, n, sizeof(*e), ent_cmp);
+	for (size_t i = 0U; i < n; i++) {
+		struct dt_idx_ent_s *x = e + res - 1U;
+
+		if (res && mergeable_p(x, e + i)) {
+			x->bhi = e[i].bhi > x->bhi ? e[i].bhi : x->bhi;
+			x->lo = e[i].lo < x->lo ? e[i].lo : x->lo;
+			x->hi = e[i].hi > x->hi ? e[i].hi : x->hi;
+			continue;
+		}
+		e[res++] = e[i];
+	}
+	return res;
+}
+
+static int
+note_bkt(struct widx_s *w, int64_t bkt, off_t off)
+{
+/* note that the line at OFF has a date/time in bucket BKT */
+	struct dt_idx_ent_s *o =
+		w->open + ((uint64_t)bkt * 0x9e3779b97f4a7c15ULL >> 58U);
+	int rc = 0;
+
+	if (o->hi && o->blo == bkt && (uint64_t)off <= o->hi + SLACK) {
+		/* just extend it */
+		o->hi = off + 1U;
+		return 0;
+	} else if (o->hi) {
+		/* make room */
+		rc = push_ent(&w->ents, *o);
+		if (w->ents.n >= w->ncompact) {
+			w->ents.n = coalesce(w->ents.e, w->ents.n);
+			w->ncompact = w->ents.n + NCOMPACT;
+		}
+	}
+	*o = (struct dt_idx_ent_s){bkt, bkt, off, off + 1U};
+	return rc;
+}
+
+static int
+proc_line(void *clo, char *line, size_t llen, off_t off)
+{
+	struct widx_s *w = clo;
+	const struct prln_ctx_s ctx = w->ctx;
+	/* the bit of the line we scan, all of it or just one field */
+	char *fp = line;
+	size_t flen = llen;
+	int rc = 0;
+
+	if (ctx.fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, ctx.fld);
+		/* \0-terminate the field for the parsers */
+		fp[flen] = '\0';
+	}
+	/* every date/time on the line counts, like in dgrep */
+	for (char *lp = fp, *const zp = fp + flen, *sp, *ep;; lp = ep) {
+		struct dt_dt_s d =
+			dt_io_find_strpdt2(
+				lp, zp - lp, ctx.ndl, &sp, &ep, ctx.fromz);
+
+		if (dt_unk_p(d)) {
+			break;
+		}
+		rc |= note_bkt(w, dt_idx_bkt(d, ctx.width), off);
+	}
+	return rc;
+}
+
+static void*
+work(void *arg)
+{
+	struct widx_s *w = arg;
+
+	w->rc = dt_idx_scan(w->fd, w->lo, w->hi, proc_line, w);
+	/* retire the entries that are still open */
+	for (size_t i = 0U; i < countof(w->open); i++) {
+		if (w->open[i].hi) {
+			w->rc |= push_ent(&w->ents, w->open[i]);
+		}
+	}
+	return NULL;
+}
+
+static int
+wr_idx(const char *fn, const struct dt_idx_hdr_s *hdr,
+       const struct dt_idx_ent_s *e)
+{
+	FILE *f;
+	int rc = 0;
+
+	if ((f = fopen(fn, "w")) == NULL) {
+		return -1;
+	}
+	if (fwrite(hdr, sizeof(*hdr), 1U, f) < 1U ||
+	    fwrite(e, sizeof(*e), hdr->nent, f) < hdr->nent) {
+		rc = -1;
+	}
+	if (fclose(f)) {
+		rc = -1;
+	}
+	return rc;
+}
+
+static int
+idx_file(struct prln_ctx_s ctx, const char *fn, const char *ofn, int njob)
+{
+	struct widx_s *w;
+	struct ents_s all = {NULL};
+	struct stat st;
+	int fd;
+	int rc = 0;
+
+	if ((fd = open(fn, O_RDONLY)) < 0) {
+		serror("Error: cannot open file `%s'", fn);
+		return -1;
+	} else if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		error("Error: cannot index `%s', not a regular file", fn);
+		close(fd);
+		return -1;
+	} else if (UNLIKELY((w = calloc(njob, sizeof(*w))) == NULL)) {
+		close(fd);
+		return -1;
+	}
+
+	/* hand out bits of equal size, aligned to lines */
+	for (int i = 0; i < njob; i++) {
+		off_t lo = dt_idx_next_line(fd, (off_t)(st.st_size / njob * i));
+
+		w[i].ctx = ctx;
+		w[i].fd = fd;
+		w[i].lo = lo >= 0 ? lo : st.st_size;
+		w[i].hi = st.st_size;
+		w[i].ncompact = NCOMPACT;
+		if (i) {
+			w[i - 1].hi = w[i].lo;
+		}
+	}
+#if defined HAVE_PTHREAD_H
+	for (int i = 1; i < njob; i++) {
+		if (pthread_create(&w[i].thr, NULL, work, w + i)) {
+			/* do it ourselves then */
+			work(w + i);
+			w[i].thr = pthread_self();
+		}
+	}
+	work(w);
+	for (int i = 1; i < njob; i++) {
+		if (!pthread_equal(w[i].thr, pthread_self())) {
+			pthread_join(w[i].thr, NULL);
+		}
+	}
+#else  /* !HAVE_PTHREAD_H */
+	for (int i = 0; i < njob; i++) {
+		work(w + i);
+	}
+#endif	/* HAVE_PTHREAD_H */
+
+	for (int i = 0; i < njob; i++) {
+		for (size_t j = 0U; j < w[i].ents.n; j++) {
+			rc |= push_ent(&all, w[i].ents.e[j]);
+		}
+		rc |= w[i].rc;
+		free(w[i].ents.e);
+	}
+	free(w);
+	close(fd);
+
+	if (rc < 0) {
+		serror("Error: cannot index `%s'", fn);
+	} else {
+		struct dt_idx_hdr_s hdr = {
+			.magic = DT_IDX_MAGIC,
+			.ver = DT_IDX_VERSION,
+			.width = ctx.width,
+			.fsz = st.st_size,
+			.mtim = st.st_mtime,
+			.sig = ctx.sig,
+			.nent = coalesce(all.e, all.n),
+		};
+		size_t z = strlen(fn);
+		char dfn[ofn == NULL ? z + sizeof(".dtidx") : 1U];
+
+		if (ofn == NULL) {
+			memcpy(dfn, fn, z);
+			memcpy(dfn + z, ".dtidx", sizeof(".dtidx"));
+			ofn = dfn;
+		}
+		if ((rc = wr_idx(ofn, &hdr, all.e)) < 0) {
+			serror("Error: cannot write index `%s'", ofn);
+		}
+	}
+	free(all.e);
+	return rc;
+}
+
+static int
+parse_width(unsigned int *tgt, const char *spec)
+{
+/* N seconds, or N suffixed by one of s, m, h, d */
+	unsigned long int x;
+	char *on;
+
+	if ((x = strtoul(spec, &on, 10)) == 0UL) {
+		return -1;
+	}
+	switch (*on) {
+	case 'd':
+		x *= 24U;
+		/*@fallthrough@*/
+	case 'h':
+		x *= 60U;
+		/*@fallthrough@*/
+	case 'm':
+		x *= 60U;
+		/*@fallthrough@*/
+	case 's':
+	case '\0':
+		break;
+	default:
+		return -1;
+	}
+	if ((*on && on[1U]) || x > UINT32_MAX) {
+		return -1;
+	}
+	*tgt = (unsigned int)x;
+	return 0;
+}
+
+
+#include "dindex.yucc"
+
+int
+main(int argc, char *argv[])
+{
+	yuck_t argi[1U];
+	char **fmt;
+	size_t nfmt;
+	zif_t fromz = NULL;
+	struct dt_io_fld_s fld;
+	unsigned int width = 60U;
+	int njob;
+	int rc = 0;
+
+	if (yuck_parse(argi, argc, argv)) {
+		rc = 1;
+		goto out;
+	} else if (dt_io_fld(&fld, argi->field_arg, argi->delimiter_arg) < 0) {
+		rc = 1;
+		goto out;
+	} else if (argi->nargs == 0U) {
+		error("Error: need a FILE to index");
+		rc = 1;
+		goto out;
+	} else if (argi->output_arg && argi->nargs > 1U) {
+		error("Error: --output can only be used with a single FILE");
+		rc = 1;
+		goto out;
+	} else if (argi->bucket_width_arg &&
+		   parse_width(&width, argi->bucket_width_arg) < 0) {
+		error("Error: invalid bucket width `%s'",
+		      argi->bucket_width_arg);
+		rc = 1;
+		goto out;
+	} else if ((njob = dt_io_par_njob(argi->jobs_arg)) < 0) {
+		error("Error: cannot parse number of jobs `%s'",
+		      argi->jobs_arg);
+		rc = 1;
+		goto out;
+	}
+	/* init and unescape sequences, maybe */
+	fmt = argi->input_format_args;
+	nfmt = argi->input_format_nargs;
+	if (argi->backslash_escapes_flag) {
+		for (size_t i = 0; i < nfmt; i++) {
+			dt_io_unescape(fmt[i]);
+		}
+	}
+
+	if (argi->from_locale_arg) {
+		setilocale(argi->from_locale_arg);
+	}
+	/* try and read the from zone */
+	if (argi->from_zone_arg &&
+	    (fromz = dt_io_zone(argi->from_zone_arg)) == NULL) {
+		error("\
+Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
+		rc = 1;
+		goto clear;
+	}
+	if (argi->base_arg) {
+		struct dt_dt_s base = dt_strpdt(argi->base_arg, NULL, NULL);
+		dt_set_base(base);
+	}
+
+	{
+		/* process all files */
+		struct grep_atom_s __nstk[16], *needle = __nstk;
+		size_t nneedle = countof(__nstk);
+		struct grep_atom_soa_s ndlsoa;
+		struct prln_ctx_s prln = {
+			.ndl = &ndlsoa,
+			.fromz = fromz,
+			.fld = fld,
+			.width = width,
+			.sig = dt_idx_sig(
+				argi->from_zone_arg, argi->from_locale_arg,
+				argi->base_arg,
+				argi->field_arg, argi->delimiter_arg,
+				fmt, nfmt),
+		};
+
+		/* lest we overflow the stack */
+		if (nfmt >= nneedle) {
+			/* round to the nearest 8-multiple */
+			nneedle = (nfmt | 7) + 1;
+			needle = calloc(nneedle, sizeof(*needle));
+		}
+		/* and now build the needles */
+		ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
+		dt_io_prep(fmt, nfmt, NULL);
+
+		for (size_t i = 0U; i < argi->nargs; i++) {
+			if (idx_file(prln, argi->args[i],
+				     argi->output_arg, njob) < 0) {
+				rc = 1;
+			}
+		}
+
+		if (needle != __nstk) {
+			free(needle);
+		}
+	}
+
+clear:
+	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
+	if (argi->from_locale_arg) {
+		setilocale(NULL);
+	}
+
+out:
+	yuck_free(argi);
+	return rc;
+}
+
+/* dindex.c ends here */
@@ -47,7 +47,7 @@
 #include "dt-io.h"
 #include "dt-core-tz-glue.h"
 #include "dt-locale.h"
-#include "prchunk.h"
+#include "dt-io-par.h"
 /* parsers and formatters */
 #include "date-core-strpf.h"
 #include "date-core-private.h"
@@ -749,30 +749,44 @@ out:
 
 struct prln_ctx_s {
 	struct grep_atom_soa_s *ndl;
+	char *const *fmt;
+	size_t nfmt;
 	const char *ofmt;
 	zif_t fromz;
 	zif_t outz;
 	int sed_mode_p;
 	int empty_mode_p;
 	int quietp;
+	struct dt_io_fld_s fld;
 
 	const struct __strpdtdur_st_s *st;
 	bool nextp;
 };
 
 static int
-proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
+proc_line(void *clo, FILE *out, char *line, size_t llen)
 {
+	const struct prln_ctx_s ctx = *(const struct prln_ctx_s*)clo;
 	struct dt_dt_s d;
 	char *sp = NULL;
 	char *ep = NULL;
 	size_t nmatch = 0U;
 	int rc = 0;
-
+	/* the bit of the line we scan, all of it or just one field */
+	char *fp = line;
+	size_t flen = llen;
+	char fc = '\0';
+
+	if (ctx.fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, ctx.fld);
+		/* \0-terminate the field for the parsers, undone below */
+		fc = fp[flen];
+		fp[flen] = '\0';
+	}
 	do {
 		/* check if line matches, */
 		d = dt_io_find_strpdt2(
-			line, llen, ctx.ndl, &sp, &ep, ctx.fromz);
+			fp, flen, ctx.ndl, &sp, &ep, ctx.fromz);
 
 		if (!dt_unk_p(d)) {
 			if (UNLIKELY(d.fix) && !ctx.quietp) {
@@ -787,26 +801,30 @@ proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
 			}
 
 			if (ctx.sed_mode_p) {
-				__io_write(line, sp - line, stdout);
-				dt_io_write(d, ctx.ofmt, ctx.outz, '\0');
+				__io_write(line, sp - line, out);
+				dt_io_fwrite(d, ctx.ofmt, ctx.outz, '\0', out);
+				flen -= (ep - fp);
 				llen -= (ep - line);
-				line = ep;
+				fp = line = ep;
 				nmatch++;
 			} else {
-				dt_io_write(d, ctx.ofmt, ctx.outz, '\n');
+				dt_io_fwrite(d, ctx.ofmt, ctx.outz, '\n', out);
 				break;
 			}
 		} else if (ctx.sed_mode_p) {
+			/* put the field delimiter back */
+			fp[flen] = fc;
 			llen = !(ctx.empty_mode_p && !nmatch) ? llen : 0U;
 			line[llen] = '\n';
-			__io_write(line, llen + 1, stdout);
+			__io_write(line, llen + 1, out);
 			break;
 		} else if (ctx.empty_mode_p) {
-			__io_write("\n", 1U, stdout);
+			__io_write("\n", 1U, out);
 			break;
 		} else {
 			/* obviously unmatched, warn about it in non -q mode */
 			if (!ctx.quietp) {
+				fp[flen] = fc;
 				dt_io_warn_strpdt(line);
 				rc = 2;
 			}
@@ -816,6 +834,44 @@ proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
 	return rc;
 }
 
+static int
+proc_exact(void *clo, FILE *out, char *line, size_t llen)
+{
+/* lines (or fields) must be a date/time in their entirety */
+	const struct prln_ctx_s *ctx = clo;
+	struct dt_dt_s d;
+	char *ep = NULL;
+
+	if (ctx->fld.fld) {
+		llen = dt_io_getfld(&line, line, llen, ctx->fld);
+		line[llen] = '\0';
+	}
+	if (UNLIKELY(!llen)) {
+		goto empty;
+	}
+	/* try and parse the line */
+	d = dt_io_strpdt_ep(line, ctx->fmt, ctx->nfmt, &ep, ctx->fromz);
+	if (UNLIKELY(dt_unk_p(d))) {
+		goto empty;
+	} else if (ep && (unsigned)*ep >= ' ') {
+		goto empty;
+	}
+	/* do the rounding */
+	d = dround(d, ctx->st->durs, ctx->st->ndurs, ctx->nextp);
+	if (UNLIKELY(dt_unk_p(d))) {
+		goto empty;
+	}
+	if (ctx->fromz != NULL) {
+		/* fixup zone */
+		d = dtz_forgetz(d, ctx->fromz);
+	}
+	dt_io_fwrite(d, ctx->ofmt, ctx->outz, '\n', out);
+	return 0;
+empty:
+	__io_write("\n", 1U, out);
+	return 0;
+}
+
 
 #include "dround.yucc"
 
@@ -834,6 +890,7 @@ main(int argc, char *argv[])
 	bool nextp = false;
 	zif_t fromz = NULL;
 	zif_t z = NULL;
+	struct dt_io_fld_s fld;
 
 	if (yuck_parse(argi, argc, argv)) {
 		rc = 1;
@@ -855,6 +912,11 @@ main(int argc, char *argv[])
 		}
 	}
 
+	if (dt_io_fld(&fld, argi->field_arg, argi->delimiter_arg) < 0) {
+		rc = 1;
+		goto out;
+	}
+
 	if (argi->from_locale_arg) {
 		setilocale(argi->from_locale_arg);
 	}
@@ -1046,108 +1108,87 @@ no durations given");
 		} else {
 			rc = 1;
 		}
-	} else if (!argi->sed_mode_flag && argi->empty_mode_flag) {
-		/* read from stdin in exact/empty mode */
-		size_t lno = 0;
-		void *pctx;
-
-		/* no threads reading this stream */
-		__io_setlocking_bycaller(stdout);
-
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("could not open stdin");
-			goto clear;
-		}
-
-		while (prchunk_fill(pctx) >= 0) {
-			for (char *line; prchunk_haslinep(pctx); lno++) {
-				size_t llen = prchunk_getline(pctx, &line);
-				char *ep = NULL;
-
-
-				if (UNLIKELY(!llen)) {
-					goto empty;
-				}
-				/* try and parse the line */
-				d = dt_io_strpdt_ep(line, fmt, nfmt, &ep, fromz);
-				if (UNLIKELY(dt_unk_p(d))) {
-					goto empty;
-				} else if (ep && (unsigned)*ep >= ' ') {
-					goto empty;
-				}
-				/* do the rounding */
-				d = dround(d, st.durs, st.ndurs, nextp);
-				if (UNLIKELY(dt_unk_p(d))) {
-					goto empty;
-				}
-				if (fromz != NULL) {
-					/* fixup zone */
-					d = dtz_forgetz(d, fromz);
-				}
-				dt_io_write(d, ofmt, z, '\n');
-				continue;
-			empty:
-				__io_write("\n", 1U, stdout);
-			}
-		}
 	} else {
 		/* read from stdin */
-		size_t lno = 0;
 		struct grep_atom_s __nstk[16], *needle = __nstk;
 		size_t nneedle = countof(__nstk);
 		struct grep_atom_soa_s ndlsoa;
-		void *pctx;
 		struct prln_ctx_s prln = {
 			.ndl = &ndlsoa,
+			.fmt = fmt,
+			.nfmt = nfmt,
 			.ofmt = ofmt,
 			.fromz = fromz,
 			.outz = z,
 			.sed_mode_p = argi->sed_mode_flag,
 			.empty_mode_p = argi->empty_mode_flag,
 			.quietp = argi->quiet_flag,
+			.fld = fld,
 			.st = &st,
 			.nextp = nextp,
 		};
+		/* in exact mode lines must be date/times in their entirety */
+		const bool exactp =
+			!argi->sed_mode_flag && argi->empty_mode_flag;
+		int njob;
+
+		if ((njob = dt_io_par_njob(argi->jobs_arg)) < 0) {
+			error("Error: cannot parse number of jobs `%s'",
+			      argi->jobs_arg);
+			rc = 1;
+			goto clear;
+		}
 
-		/* no threads reading this stream */
+		/* no threads writing to this stream */
 		__io_setlocking_bycaller(stdout);
 
-		/* lest we overflow the stack */
-		if (nfmt >= nneedle) {
-			/* round to the nearest 8-multiple */
-			nneedle = (nfmt | 7) + 1;
-			needle = calloc(nneedle, sizeof(*needle));
+		if (!exactp) {
+			/* lest we overflow the stack */
+			if (nfmt >= nneedle) {
+				/* round to the nearest 8-multiple */
+				nneedle = (nfmt | 7) + 1;
+				needle = calloc(nneedle, sizeof(*needle));
+			}
+			/* and now build the needle */
+			ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
 		}
-		/* and now build the needle */
-		ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
-
+		dt_io_prep(fmt, nfmt, ofmt);
 
-		/* using the prchunk reader now */
-		if ((pctx = init_prchunk(STDIN_FILENO)) == NULL) {
-			serror("Error: could not open stdin");
-			goto ndl_free;
-		}
-		while (prchunk_fill(pctx) >= 0) {
-			for (char *line; prchunk_haslinep(pctx); lno++) {
-				size_t llen = prchunk_getline(pctx, &line);
+		/* njob can be large, keep the closures off the stack */
+		struct prln_ctx_s *clo = calloc(njob, sizeof(*clo));
+		void **cp = calloc(njob, sizeof(*cp));
+		int r;
 
-				rc |= proc_line(prln, line, llen);
+		if (UNLIKELY(clo == NULL || cp == NULL)) {
+			serror("Error: cannot allocate job closures");
+			rc = 1;
+		} else {
+			for (int i = 0; i < njob; i++) {
+				clo[i] = prln;
+				cp[i] = clo + i;
+			}
+			r = dt_io_par(
+				STDIN_FILENO,
+				exactp ? proc_exact : proc_line, cp, njob);
+			if (r < 0) {
+				serror("Error: could not open stdin");
+				rc = 1;
+			} else {
+				rc |= r;
 			}
 		}
-		/* get rid of resources */
-		free_prchunk(pctx);
-	ndl_free:
+		free(clo);
+		free(cp);
 		if (needle != __nstk) {
 			free(needle);
 		}
-		goto out;
 	}
 clear:
 	/* free the strpdur status */
 	__strpdtdur_free(&st);
 
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
@@ -41,8 +41,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <sys/time.h>
-#include <sys/wait.h>
 #include <fcntl.h>
 #include <time.h>
 
@@ -56,71 +57,209 @@ const char *prog = "dsort";
 struct prln_ctx_s {
 	struct grep_atom_soa_s *ndl;
 	zif_t fromz;
-	int outfd;
+	struct dt_io_fld_s fld;
 };
 
 struct sort_ctx_s {
 	unsigned int revp:1U;
 	unsigned int unqp:1U;
+	/* bytes of lines and keys to keep in memory, 0 for no limit */
+	size_t bufz;
+	/* directory for runs */
+	const char *tmpd;
 };
 
-
-static void
-safe_write(int fd, const char *buf, size_t bsz)
+/* sort keys, the date/time (see dt_key()) and the input line number */
+struct key_s {
+	uint64_t k;
+	uint32_t ns;
+	uint32_t lno;
+};
+
+/* record in a run, followed by LEN bytes of line text sans \n */
+struct rrec_s {
+	uint64_t k;
+	uint32_t ns;
+	uint32_t len;
+};
+
+/* a sorted run, bytes [LO, HI) of the temporary file of its level */
+struct run_s {
+	off_t lo;
+	off_t hi;
+	unsigned int lvl;
+};
+
+/* sorted runs in input order, spilled runs are of level 0 and merging
+ * the runs of level L makes one of level L + 1, so levels never increase
+ * along R, and the runs of level L are back to back in F[L] */
+struct runs_s {
+	struct run_s *r;
+	size_t n;
+	size_t z;
+	FILE *f[16U];
+};
+
+/* the lines read so far and their keys */
+struct lines_s {
+	/* line texts, each \n-terminated, back to back */
+	char *txt;
+	size_t ntxt;
+	size_t ztxt;
+	/* offsets of the lines in TXT, NLIN + 1 of them */
+	size_t *off;
+	struct key_s *key;
+	size_t nlin;
+	size_t zlin;
+};
+
+
+static struct key_s
+dt_key(struct dt_dt_s d)
 {
-	size_t tot = 0U;
-	for (ssize_t nwr;
-	     tot < bsz && (nwr = write(fd, buf + tot, bsz - tot)) >= 0;
-	     tot += nwr);
-	return;
+/* map D to a key that orders like the %F\001%T strings we used to hand
+ * to sort(1), i.e. lines without date/times first, then times, then
+ * dates and date/times, and dates before date/times on the same day,
+ * bit layout of K is
+ *   2 bits class (0 none, 1 time, 2 date)
+ *   22 bits ymd (y:12 m:4 d:6)
+ *   1 bit has time
+ *   24 bits time (h:8 m:8 s:8)
+ * the nanoseconds go into NS */
+	struct key_s res = {0U};
+
+	if (dt_unk_p(d)) {
+		return res;
+	} else if (UNLIKELY(!dt_separable_p(d))) {
+		d = dt_dtconv((dt_dttyp_t)DT_YMD, d);
+	}
+	if (dt_sandwich_only_t_p(d)) {
+		res.k = 1ULL << 62U;
+	} else {
+		if (d.d.typ != DT_YMD) {
+			d.d = dt_dconv(DT_YMD, d.d);
+		}
+		res.k = 2ULL << 62U;
+		res.k ^= (uint64_t)d.d.ymd.y << 35U;
+		res.k ^= (uint64_t)d.d.ymd.m << 31U;
+		res.k ^= (uint64_t)d.d.ymd.d << 25U;
+		if (dt_sandwich_only_d_p(d)) {
+			return res;
+		}
+	}
+	res.k ^= 1ULL << 24U;
+	res.k ^= d.t.hms.u24;
+	res.ns = d.t.hms.ns;
+	return res;
 }
 
-static void
-proc_line(struct prln_ctx_s ctx, char *line, size_t llen)
+static int
+push_line(struct lines_s *restrict ls, const char *line, size_t llen)
 {
-	struct dt_dt_s d;
+/* copy LINE into LS, along with its terminating \n */
+	if (UNLIKELY(ls->ntxt + llen + 1U > ls->ztxt)) {
+		size_t nu = ls->ztxt ?: 65536U;
+		char *tmp;
 
-	do {
-		char buf[64U];
-		char *sp, *tp;
-		char *bp = buf;
-		const char *const ep = buf + sizeof(buf);
-
-		/* find first occurrence then */
-		d = dt_io_find_strpdt2(
-			line, llen, ctx.ndl, &sp, &tp, ctx.fromz);
-		/* print line, first thing */
-		safe_write(ctx.outfd, line, llen);
-
-		/* extend by separator */
-		*bp++ = '\001';
-		/* check if line matches */
-		if (!dt_unk_p(d)) {
-			/* match! */
-			if (!dt_sandwich_only_t_p(d)) {
-				bp += dt_strfdt(bp, ep - bp, "%F", d);
-			}
-			*bp++ = '\001';
-			if (!dt_sandwich_only_d_p(d)) {
-				bp += dt_strfdt(bp, ep - bp, "%T", d);
-			}
-		} else {
-			/* just two empty fields then, innit? */
-			*bp++ = '\001';
+		while (nu < ls->ntxt + llen + 1U) {
+			nu *= 2U;
 		}
-		/* finalise the line and print */
-		*bp++ = '\n';
-		safe_write(ctx.outfd, buf, bp - buf);
-	} while (0);
-	return;
+		if (UNLIKELY((tmp = realloc(ls->txt, nu)) == NULL)) {
+			return -1;
+		}
+		ls->txt = tmp;
+		ls->ztxt = nu;
+	}
+	if (UNLIKELY(ls->nlin + 1U >= ls->zlin)) {
+		size_t nu = ls->zlin ? ls->zlin * 2U : 4096U;
+		size_t *otmp;
+		struct key_s *ktmp;
+
+		if (UNLIKELY(ls->nlin >= UINT32_MAX)) {
+			return -1;
+		} else if (UNLIKELY((otmp = realloc(
+					     ls->off,
+					     nu * sizeof(*ls->off))) == NULL)) {
+			return -1;
+		}
+		ls->off = otmp;
+		if (UNLIKELY((ktmp = realloc(
+				      ls->key,
+				      nu * sizeof(*ls->key))) == NULL)) {
+			return -1;
+		}
+		ls->key = ktmp;
+		ls->zlin = nu;
+	}
+	ls->off[ls->nlin] = ls->ntxt;
+	memcpy(ls->txt + ls->ntxt, line, llen);
+	ls->ntxt += llen;
+	ls->txt[ls->ntxt++] = '\n';
+	ls->off[++ls->nlin] = ls->ntxt;
+	return 0;
+}
+
+static struct key_s
+line_key(struct prln_ctx_s ctx, char *line, size_t llen)
+{
+/* return the sort key of LINE */
+	struct dt_dt_s d;
+	char *sp, *tp;
+	/* the bit of the line we scan, all of it or just one field */
+	char *fp = line;
+	size_t flen = llen;
+	char fc = '\0';
+
+	if (ctx.fld.fld) {
+		flen = dt_io_getfld(&fp, line, llen, ctx.fld);
+		/* \0-terminate the field for the parsers */
+		fc = fp[flen];
+		fp[flen] = '\0';
+	}
+	/* find first occurrence then */
+	d = dt_io_find_strpdt2(fp, flen, ctx.ndl, &sp, &tp, ctx.fromz);
+	/* put the field delimiter back */
+	fp[flen] = fc;
+	return dt_key(d);
 }
 
 static int
-proc_file(struct prln_ctx_s prln, const char *fn)
+proc_line(struct prln_ctx_s ctx, struct lines_s *ls, char *line, size_t llen)
+{
+/* LINE needn't be \0-terminated, we work on our copy of it */
+	char *cp;
+
+	if (UNLIKELY(push_line(ls, line, llen) < 0)) {
+		return -1;
+	}
+	/* \0-terminate the copy for the parsers */
+	cp = ls->txt + ls->off[ls->nlin - 1U];
+	cp[llen] = '\0';
+	ls->key[ls->nlin - 1U] = line_key(ctx, cp, llen);
+	ls->key[ls->nlin - 1U].lno = (uint32_t)(ls->nlin - 1U);
+	cp[llen] = '\n';
+	return 0;
+}
+
+static inline size_t
+lines_size(const struct lines_s *ls)
 {
+/* approximate memory needed to sort LS */
+	return ls->ntxt + ls->nlin * (sizeof(*ls->off) + 2U * sizeof(*ls->key));
+}
+
+static int spill(struct lines_s*, struct sort_ctx_s, struct runs_s*);
+
+static int
+proc_file(struct prln_ctx_s prln, struct lines_s *ls,
+	  struct sort_ctx_s sopt, struct runs_s *rs, const char *fn)
+{
+/* read the lines of FN into LS, spilling runs to RS as needed,
+ * return -1 if FN can't be read and -2 if lines have been lost */
 	size_t lno = 0;
 	void *pctx;
 	int fd;
+	int rc = 0;
 
 	if (fn == NULL) {
 		/* stdin then innit */
@@ -130,8 +269,8 @@ proc_file(struct prln_ctx_s prln, const char *fn)
 		return -1;
 	}
 
-	/* using the prchunk reader now */
-	if ((pctx = init_prchunk(fd)) == NULL) {
+	/* using the prchunk reader now, lines are copied anyway */
+	if ((pctx = init_prchunk_ro(fd)) == NULL) {
 		serror("Error: cannot read from `%s'", fn ?: "<stdin>");
 		return -1;
 	}
@@ -140,102 +279,725 @@ proc_file(struct prln_ctx_s prln, const char *fn)
 		for (char *line; prchunk_haslinep(pctx); lno++) {
 			size_t llen = prchunk_getline(pctx, &line);
 
-			proc_line(prln, line, llen);
+			if (UNLIKELY(proc_line(prln, ls, line, llen) < 0)) {
+				serror("Error: cannot keep all lines in memory");
+				rc = -2;
+				goto out;
+			} else if (sopt.bufz && lines_size(ls) >= sopt.bufz &&
+				   UNLIKELY(spill(ls, sopt, rs) < 0)) {
+				serror("Error: cannot write temporary file");
+				rc = -2;
+				goto out;
+			}
 		}
 	}
+out:
 	/* get rid of resources */
 	free_prchunk(pctx);
 	close(fd);
+	return rc;
+}
+
+
+/* the sorter */
+static inline unsigned int
+key_digit(struct key_s k, unsigned int i, uint64_t flip)
+{
+/* return the I-th radix digit of K, least significant first,
+ * the 4 bytes of the nanoseconds go first, then the 8 bytes of K,
+ * FLIP is xor'd in to reverse the order */
+	if (i < 4U) {
+		return ((k.ns ^ (uint32_t)flip) >> (i * 8U)) & 0xffU;
+	}
+	return ((k.k ^ flip) >> ((i - 4U) * 8U)) & 0xffU;
+}
+
+static int
+radix_sort(struct key_s *k, size_t n, bool revp)
+{
+/* stable LSD radix sort of K by (k, ns), descending if REVP,
+ * digits that are the same across all keys are skipped */
+	static size_t cnt[12U][256U];
+	const uint64_t flip = revp ? ~0ULL : 0ULL;
+	struct key_s *src = k;
+	struct key_s *dst;
+
+	if (n <= 1U) {
+		return 0;
+	} else if (UNLIKELY((dst = malloc(n * sizeof(*dst))) == NULL)) {
+		return -1;
+	}
+	/* all histograms in one go */
+	memset(cnt, 0, sizeof(cnt));
+	for (size_t i = 0U; i < n; i++) {
+		for (unsigned int j = 0U; j < countof(cnt); j++) {
+			cnt[j][key_digit(k[i], j, flip)]++;
+		}
+	}
+	for (unsigned int j = 0U; j < countof(cnt); j++) {
+		size_t sum = 0U;
+
+		if (cnt[j][key_digit(*src, j, flip)] == n) {
+			/* all keys agree on this digit */
+			continue;
+		}
+		/* turn counts into offsets */
+		for (size_t b = 0U; b < countof(*cnt); b++) {
+			size_t c = cnt[j][b];
+
+			cnt[j][b] = sum;
+			sum += c;
+		}
+		for (size_t i = 0U; i < n; i++) {
+			dst[cnt[j][key_digit(src[i], j, flip)]++] = src[i];
+		}
+		with (struct key_s *tmp = src) {
+			src = dst;
+			dst = tmp;
+		}
+	}
+	if (src != k) {
+		memcpy(k, src, n * sizeof(*k));
+		dst = src;
+	}
+	free(dst);
 	return 0;
 }
 
-
-/* helper children, sort(1) and cut(1) */
-static pid_t
-spawn_sort(int *restrict infd, const int outfd, struct sort_ctx_s sopt)
+static inline void
+wr_line(FILE *out, bool runp, uint64_t k, uint32_t ns, const char *ln, size_t len)
 {
-	static char *cmdline[16U] = {"sort", "-t", "-k2"};
-	pid_t sortp;
-	/* to snarf off traffic from the child */
-	int intfd[2];
+/* write LN to OUT, as run record if RUNP, as line otherwise */
+	if (runp) {
+		const struct rrec_s r = {k, ns, (uint32_t)len};
+
+		__io_write((const char*)&r, sizeof(r), out);
+		__io_write(ln, len, out);
+		return;
+	}
+	__io_write(ln, len, out);
+	__io_putc('\n', out);
+	return;
+}
 
-	if (pipe(intfd) < 0) {
-		serror("pipe setup to/from sort failed");
+static void
+prnt_lines(const struct lines_s *ls, struct sort_ctx_s sopt, FILE *out, bool runp)
+{
+	for (size_t i = 0U; i < ls->nlin; i++) {
+		const struct key_s k = ls->key[i];
+		const size_t o = ls->off[k.lno];
+
+		if (sopt.unqp && i &&
+		    k.k == ls->key[i - 1U].k && k.ns == ls->key[i - 1U].ns) {
+			/* only the first of a run of equal keys */
+			continue;
+		}
+		wr_line(out, runp, k.k, k.ns,
+			ls->txt + o, ls->off[k.lno + 1U] - o - 1U);
+	}
+	return;
+}
+
+
+/* external sorting */
+#define RUN_BUFZ	(65536U)
+/* number of runs of a level that get merged into one of the next */
+#define MAX_FANIN	(128U)
+
+static FILE*
+mkrun(const char *tmpd)
+{
+/* create an anonymous temporary file in TMPD */
+	static const char sfx[] = "/dsort.XXXXXX";
+	const size_t n = strlen(tmpd);
+	char tmpl[n + sizeof(sfx)];
+	FILE *res;
+	int fd;
+
+	memcpy(tmpl, tmpd, n);
+	memcpy(tmpl + n, sfx, sizeof(sfx));
+	if ((fd = mkstemp(tmpl)) < 0) {
+		return NULL;
+	}
+	/* nobody else needs to see it */
+	unlink(tmpl);
+	if (UNLIKELY((res = fdopen(fd, "w+")) == NULL)) {
+		close(fd);
+		return NULL;
+	}
+	setvbuf(res, NULL, _IOFBF, RUN_BUFZ);
+	__io_setlocking_bycaller(res);
+	return res;
+}
+
+/* the merger, a loser tree over the current records of K sources */
+struct mrg_s {
+	/* a run, bytes [OFF, END) of FD buffered in BUF,
+	 * or an input file FD read through PCTX */
+	int fd;
+	off_t off;
+	off_t end;
+	char *buf;
+	size_t bz;
+	size_t bo;
+	size_t bn;
+	prch_ctx_t pctx;
+	bool eofp;
+	/* the current record and its line */
+	struct rrec_s r;
+	char *ln;
+	size_t lz;
+	/* key extraction for input files */
+	const struct prln_ctx_s *prln;
+};
+
+static int
+mrg_next_line(struct mrg_s *m)
+{
+/* read the next line of input file M, return -1 if it cannot be read */
+	struct key_s k;
+	size_t llen;
+
+	if (!prchunk_haslinep(m->pctx) && prchunk_fill(m->pctx) < 0) {
+		free_prchunk(m->pctx);
+		close(m->fd);
+		m->pctx = NULL;
+		m->eofp = true;
+		return 0;
+	}
+	llen = prchunk_getline_rw(m->pctx, &m->ln);
+	if (UNLIKELY(m->ln == NULL)) {
+		m->eofp = true;
 		return -1;
 	}
+	k = line_key(*m->prln, m->ln, llen);
+	m->r = (struct rrec_s){k.k, k.ns, (uint32_t)llen};
+	return 0;
+}
+
+static size_t
+mrg_rd(struct mrg_s *m, void *tgt, size_t n)
+{
+/* copy the next N bytes of run M to TGT, return the number of bytes
+ * copied, less than N only at the end of the run or on read errors */
+	char *tp = tgt;
+	size_t res = 0U;
+
+	while (res < n) {
+		size_t k;
 
-	switch ((sortp = vfork())) {
-	case -1:
-		/* i am an error */
-		serror("vfork for sort failed");
+		if (m->bo >= m->bn) {
+			const off_t left = m->end - m->off;
+			ssize_t nrd;
+
+			k = left < (off_t)m->bz ? (size_t)left : m->bz;
+			if (!k || (nrd = pread(m->fd, m->buf, k, m->off)) <= 0) {
+				break;
+			}
+			m->off += nrd;
+			m->bo = 0U;
+			m->bn = nrd;
+		}
+		k = m->bn - m->bo < n - res ? m->bn - m->bo : n - res;
+		memcpy(tp + res, m->buf + m->bo, k);
+		m->bo += k;
+		res += k;
+	}
+	return res;
+}
+
+static int
+mrg_next(struct mrg_s *m)
+{
+/* read the next record of M, return -1 if it cannot be read */
+	size_t nrd;
+
+	if (m->pctx != NULL) {
+		return mrg_next_line(m);
+	} else if (UNLIKELY((nrd = mrg_rd(m, &m->r, sizeof(m->r))) <
+			    sizeof(m->r))) {
+		/* only the end of the run is fine */
+		m->eofp = true;
+		return nrd || m->off < m->end ? -1 : 0;
+	}
+	if (UNLIKELY(m->r.len > m->lz)) {
+		size_t nu = m->lz ?: 256U;
+		char *tmp;
+
+		while (nu < m->r.len) {
+			nu *= 2U;
+		}
+		if ((tmp = realloc(m->ln, nu)) == NULL) {
+			m->eofp = true;
+			return -1;
+		}
+		m->ln = tmp;
+		m->lz = nu;
+	}
+	if (UNLIKELY(mrg_rd(m, m->ln, m->r.len) < m->r.len)) {
+		m->eofp = true;
 		return -1;
+	}
+	return 0;
+}
 
-	default:
-		/* i am the parent */
-		close(intfd[0]);
-		*infd = intfd[1];
-		/* close outfd here already */
-		close(outfd);
-		return sortp;
+static inline bool
+mrg_less(const struct mrg_s *m, size_t k, size_t i, size_t j, uint64_t flip)
+{
+/* the virtual leaf K beats everyone, exhausted sources lose to everyone,
+ * and on equal keys the earlier source wins */
+	if (UNLIKELY(i == k)) {
+		return true;
+	} else if (UNLIKELY(j == k)) {
+		return false;
+	} else if (UNLIKELY(m[i].eofp)) {
+		return false;
+	} else if (UNLIKELY(m[j].eofp)) {
+		return true;
+	} else if (m[i].r.k != m[j].r.k) {
+		return (m[i].r.k ^ flip) < (m[j].r.k ^ flip);
+	} else if (m[i].r.ns != m[j].r.ns) {
+		return (m[i].r.ns ^ (uint32_t)flip) < (m[j].r.ns ^ (uint32_t)flip);
+	}
+	return i < j;
+}
+
+static inline void
+mrg_adjust(size_t *restrict t, const struct mrg_s *m, size_t k, size_t s,
+	   uint64_t flip)
+{
+/* replay the matches from leaf S up, T[0] ends up with the winner */
+	size_t w = s;
+
+	for (size_t p = (s + k) / 2U; p > 0U; p /= 2U) {
+		if (mrg_less(m, k, t[p], w, flip)) {
+			/* the stored loser wins this one */
+			size_t tmp = t[p];
+			t[p] = w;
+			w = tmp;
+		}
+	}
+	t[0U] = w;
+	return;
+}
 
-	case 0:;
-		char **cp = cmdline + 3U;
+static int
+mrg_loop(struct mrg_s *m, size_t k, struct sort_ctx_s sopt, FILE *out, bool runp)
+{
+/* merge the K primed sources M into OUT, as run if RUNP */
+	const uint64_t flip = sopt.revp ? ~0ULL : 0ULL;
+	size_t *t;
+	struct rrec_s last = {0U};
+	bool anyp = false;
+	int rc = 0;
 
-		/* i am the child */
-		if (sopt.revp) {
-			*cp++ = "-r";
+	if (UNLIKELY((t = calloc(k, sizeof(*t))) == NULL)) {
+		return -1;
+	}
+	for (size_t i = 0U; i < k; i++) {
+		t[i] = k;
+	}
+	for (size_t i = k; i-- > 0U;) {
+		mrg_adjust(t, m, k, i, flip);
+	}
+	for (struct mrg_s *w; k && !(w = m + t[0U])->eofp;) {
+		if (!sopt.unqp || !anyp ||
+		    w->r.k != last.k || w->r.ns != last.ns) {
+			wr_line(out, runp, w->r.k, w->r.ns, w->ln, w->r.len);
 		}
-		if (sopt.unqp) {
-			*cp++ = "-u";
+		last = w->r;
+		anyp = true;
+		if (UNLIKELY(mrg_next(w) < 0)) {
+			rc = -1;
+			break;
 		}
-		*cp++ = NULL;
+		mrg_adjust(t, m, k, t[0U], flip);
+	}
+	free(t);
+	return rc;
+}
+
+static int
+merge(const struct runs_s *rs, size_t i0, size_t k,
+      struct sort_ctx_s sopt, FILE *out, bool runp)
+{
+/* merge the K runs of RS starting at I0 into OUT, as run if RUNP */
+	/* wide merges get smaller buffers */
+	const size_t bz = k <= MAX_FANIN ? RUN_BUFZ : RUN_BUFZ * MAX_FANIN / k;
+	struct mrg_s *m;
+	int rc = 0;
+
+	if (UNLIKELY((m = calloc(k, sizeof(*m))) == NULL)) {
+		return -1;
+	}
+	for (size_t i = 0U; i < k; i++) {
+		const struct run_s r = rs->r[i0 + i];
+
+		m[i].fd = fileno(rs->f[r.lvl]);
+		m[i].off = r.lo;
+		m[i].end = r.hi;
+		m[i].bz = bz;
+		if (UNLIKELY((m[i].buf = malloc(bz)) == NULL)) {
+			rc = -1;
+		} else if (UNLIKELY(mrg_next(m + i) < 0)) {
+			rc = -1;
+		}
+	}
+	if (LIKELY(!rc)) {
+		rc = mrg_loop(m, k, sopt, out, runp);
+	}
+	for (size_t i = 0U; i < k; i++) {
+		free(m[i].buf);
+		free(m[i].ln);
+	}
+	free(m);
+	return rc;
+}
+
+static FILE*
+lvl_file(struct runs_s *rs, unsigned int lvl, struct sort_ctx_s sopt)
+{
+/* return the temporary file for runs of level LVL, create it if need be */
+	if (UNLIKELY(lvl >= countof(rs->f))) {
+		return NULL;
+	} else if (rs->f[lvl] == NULL) {
+		rs->f[lvl] = mkrun(sopt.tmpd);
+	}
+	return rs->f[lvl];
+}
+
+static int
+push_run(struct runs_s *rs, unsigned int lvl, off_t lo)
+{
+/* finish writing the run of level LVL that starts at LO in its file,
+ * and append it to RS */
+	FILE *f = rs->f[lvl];
+	off_t hi;
+
+	if (UNLIKELY(fflush(f) || ferror(f) || (hi = ftello(f)) < 0)) {
+		return -1;
+	}
+	if (UNLIKELY(rs->n >= rs->z)) {
+		size_t nu = rs->z ? rs->z * 2U : 16U;
+		struct run_s *tmp;
+
+		if ((tmp = realloc(rs->r, nu * sizeof(*rs->r))) == NULL) {
+			return -1;
+		}
+		rs->r = tmp;
+		rs->z = nu;
+	}
+	rs->r[rs->n++] = (struct run_s){lo, hi, lvl};
+	return 0;
+}
+
+static int
+settle_runs(struct runs_s *rs, struct sort_ctx_s sopt)
+{
+/* merge the newest level into one run of the next level as soon as
+ * it's got MAX_FANIN runs, so every line is rewritten once per level,
+ * and empty that level's file */
+	while (rs->n >= MAX_FANIN) {
+		const size_t n = rs->n;
+		const unsigned int l = rs->r[n - 1U].lvl;
+		FILE *f;
+		off_t lo;
+
+		if (rs->r[n - MAX_FANIN].lvl != l) {
+			/* not yet */
+			break;
+		} else if (UNLIKELY((f = lvl_file(rs, l + 1U, sopt)) == NULL ||
+				    (lo = ftello(f)) < 0)) {
+			return -1;
+		} else if (UNLIKELY(merge(rs, n - MAX_FANIN, MAX_FANIN,
+					  sopt, f, true) < 0)) {
+			return -1;
+		}
+		rs->n -= MAX_FANIN;
+		if (UNLIKELY(push_run(rs, l + 1U, lo) < 0)) {
+			return -1;
+		}
+		/* level L is empty now */
+		f = rs->f[l];
+		if (UNLIKELY(fflush(f) || fseeko(f, 0, SEEK_SET) < 0 ||
+			     ftruncate(fileno(f), 0) < 0)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+spill(struct lines_s *ls, struct sort_ctx_s sopt, struct runs_s *rs)
+{
+/* sort LS into a new run and start afresh, then merge what's due */
+	FILE *f;
+	off_t lo;
+
+	if (UNLIKELY(radix_sort(ls->key, ls->nlin, sopt.revp) < 0)) {
+		return -1;
+	} else if (UNLIKELY((f = lvl_file(rs, 0U, sopt)) == NULL ||
+			    (lo = ftello(f)) < 0)) {
+		return -1;
+	}
+	prnt_lines(ls, sopt, f, true);
+	ls->ntxt = 0U;
+	ls->nlin = 0U;
+	if (UNLIKELY(push_run(rs, 0U, lo) < 0)) {
+		return -1;
+	}
+	return settle_runs(rs, sopt);
+}
+
+static int
+merge_runs(struct runs_s *rs, struct sort_ctx_s sopt)
+{
+/* merge all runs in RS onto stdout, that's fewer than MAX_FANIN runs
+ * per level and the levels grow logarithmically */
+	return merge(rs, 0U, rs->n, sopt, stdout, false);
+}
+
+static int
+merge_files(struct prln_ctx_s prln, struct sort_ctx_s sopt,
+	    char *const *fn, size_t nfn)
+{
+/* merge the already sorted files FN onto stdout */
+	struct mrg_s *m;
+	int rc = 0;
+
+	if (UNLIKELY((m = calloc(nfn ?: 1U, sizeof(*m))) == NULL)) {
+		serror("Error: cannot allocate merger");
+		return -1;
+	}
+	for (size_t i = 0U; i < nfn || i == 0U; i++) {
+		m[i].prln = &prln;
+		m[i].eofp = true;
+		if (!nfn) {
+			/* stdin then innit */
+			m[i].fd = STDIN_FILENO;
+		} else if ((m[i].fd = open(fn[i], O_RDONLY)) < 0) {
+			serror("Error: cannot open file `%s'", fn[i]);
+			rc = -1;
+			continue;
+		}
+		if ((m[i].pctx = init_prchunk_ro(m[i].fd)) == NULL) {
+			serror("Error: cannot read from `%s'",
+			       nfn ? fn[i] : "<stdin>");
+			close(m[i].fd);
+			rc = -1;
+			continue;
+		} else if (prchunk_fill(m[i].pctx) < 0) {
+			/* empty */
+			free_prchunk(m[i].pctx);
+			close(m[i].fd);
+			m[i].pctx = NULL;
+			continue;
+		}
+		m[i].eofp = false;
+		if (UNLIKELY(mrg_next(m + i) < 0)) {
+			rc = -1;
+		}
+	}
+	if (UNLIKELY(mrg_loop(m, nfn ?: 1U, sopt, stdout, false) < 0)) {
+		serror("Error: cannot merge files");
+		rc = -1;
+	}
+	for (size_t i = 0U; i < nfn || i == 0U; i++) {
+		if (m[i].pctx != NULL) {
+			free_prchunk(m[i].pctx);
+			close(m[i].fd);
+		}
+	}
+	free(m);
+	return rc;
+}
+
+static int
+sort_files(struct prln_ctx_s prln, struct sort_ctx_s sopt,
+	   char *const *fn, size_t nfn)
+{
+/* sort the lines of files FN onto stdout */
+	struct lines_s ls = {NULL};
+	struct runs_s rs = {NULL};
+	int rc = 0;
+
+	for (size_t i = 0U; i < nfn || i == 0U; i++) {
+		switch (proc_file(prln, &ls, sopt, &rs, nfn ? fn[i] : NULL)) {
+		case 0:
+			break;
+		case -1:
+			rc = -1;
+			break;
+		default:
+			/* whatever we'd print now would be incomplete */
+			rc = -1;
+			goto out;
+		}
+	}
 
-		/* stdout -> outfd */
-		dup2(outfd, STDOUT_FILENO);
-		/* *infd -> stdin */
-		dup2(intfd[0], STDIN_FILENO);
-		close(intfd[1]);
+	if (!rs.n && radix_sort(ls.key, ls.nlin, sopt.revp) < 0) {
+		serror("Error: cannot sort lines");
+		rc = -1;
+	} else if (!rs.n) {
+		prnt_lines(&ls, sopt, stdout, false);
+	} else if (ls.nlin && spill(&ls, sopt, &rs) < 0) {
+		serror("Error: cannot write temporary file");
+		rc = -1;
+	} else if (merge_runs(&rs, sopt) < 0) {
+		serror("Error: cannot merge temporary files");
+		rc = -1;
+	}
 
-		execvp("sort", cmdline);
-		serror("execvp(sort) failed");
-		_exit(EXIT_FAILURE);
+out:
+	for (size_t i = 0U; i < countof(rs.f); i++) {
+		if (rs.f[i] != NULL) {
+			fclose(rs.f[i]);
+		}
 	}
+	free(rs.r);
+	free(ls.txt);
+	free(ls.off);
+	free(ls.key);
+	return rc;
 }
 
-static pid_t
-spawn_cut(int *restrict infd)
+/* the checker */
+struct chck_s {
+	struct key_s last;
+	bool anyp;
+	bool quietp;
+};
+
+static int
+check_file(struct prln_ctx_s prln, struct sort_ctx_s sopt,
+	   struct chck_s *st, const char *fn)
 {
-	static char *const cmdline[] = {"cut", "-d", "-f1", NULL};
-	pid_t cutp;
-	/* to snarf off traffic from the child */
-	int intfd[2];
+/* check that the lines of FN continue the order in ST,
+ * return 1 upon the first line that doesn't, 0 if all do, -1 on error */
+	const uint64_t flip = sopt.revp ? ~0ULL : 0ULL;
+	size_t lno = 0U;
+	void *pctx;
+	int fd;
+	int rc = 0;
 
-	if (pipe(intfd) < 0) {
-		serror("pipe setup to/from cut failed");
+	if (fn == NULL) {
+		/* stdin then innit */
+		fd = STDIN_FILENO;
+	} else if ((fd = open(fn, O_RDONLY)) < 0) {
+		serror("Error: cannot open file `%s'", fn);
 		return -1;
 	}
 
-	switch ((cutp = vfork())) {
-	case -1:
-		/* i am an error */
-		serror("vfork for cut failed");
+	if ((pctx = init_prchunk_ro(fd)) == NULL) {
+		serror("Error: cannot read from `%s'", fn ?: "<stdin>");
+		close(fd);
 		return -1;
+	}
 
-	default:;
-		/* i am the parent */
-		close(intfd[0]);
-		*infd = intfd[1];
-		return cutp;
+	while (prchunk_fill(pctx) >= 0) {
+		while (prchunk_haslinep(pctx)) {
+			char *line;
+			size_t llen = prchunk_getline_rw(pctx, &line);
+			struct key_s k;
+			uint64_t kk, lk;
+			uint32_t kn, ln;
 
-	case 0:;
-		/* i am the child */
-		dup2(intfd[0], STDIN_FILENO);
-		close(intfd[1]);
+			if (UNLIKELY(line == NULL)) {
+				rc = -1;
+				goto out;
+			}
+			k = line_key(prln, line, llen);
+			kk = k.k ^ flip, lk = st->last.k ^ flip;
+			kn = k.ns ^ (uint32_t)flip;
+			ln = st->last.ns ^ (uint32_t)flip;
 
-		execvp("cut", cmdline);
-		serror("execvp(cut) failed");
-		_exit(EXIT_FAILURE);
+			lno++;
+			if (st->anyp &&
+			    (kk < lk || (kk == lk && kn < ln) ||
+			     (sopt.unqp && kk == lk && kn == ln))) {
+				if (!st->quietp) {
+					error("%s:%zu: disorder: %.*s",
+					      fn ?: "-", lno, (int)llen, line);
+				}
+				rc = 1;
+				goto out;
+			}
+			st->last = k;
+			st->anyp = true;
+		}
 	}
+out:
+	free_prchunk(pctx);
+	close(fd);
+	return rc;
+}
+
+static int
+check_files(struct prln_ctx_s prln, struct sort_ctx_s sopt,
+	    char *const *fn, size_t nfn, bool quietp)
+{
+/* check whether the concatenation of FN is sorted */
+	struct chck_s st = {.quietp = quietp};
+
+	for (size_t i = 0U; i < nfn || i == 0U; i++) {
+		int rc = check_file(prln, sopt, &st, nfn ? fn[i] : NULL);
+
+		if (rc) {
+			return rc;
+		}
+	}
+	return 0;
+}
+
+static int
+parse_size(size_t *tgt, const char *spec)
+{
+/* like sort(1)'s -S, i.e. a number optionally suffixed by one of
+ * %, b, K, M, G, T, the default unit being K, set TGT accordingly */
+	unsigned long long x;
+	char *on;
+
+	if ((x = strtoull(spec, &on, 10)) == 0ULL && on == spec) {
+		return -1;
+	}
+	switch (*on) {
+	case '%':
+		with (long np = sysconf(_SC_PHYS_PAGES),
+		      ps = sysconf(_SC_PAGESIZE)) {
+			if (np <= 0 || ps <= 0) {
+				return -1;
+			}
+			x = (unsigned long long)np * ps / 100ULL * x;
+		}
+		break;
+	case 'b':
+		break;
+	case 'T':
+	case 't':
+		x *= 1024ULL;
+		/*@fallthrough@*/
+	case 'G':
+	case 'g':
+		x *= 1024ULL;
+		/*@fallthrough@*/
+	case 'M':
+	case 'm':
+		x *= 1024ULL;
+		/*@fallthrough@*/
+	case '\0':
+	case 'K':
+	case 'k':
+		x *= 1024ULL;
+		break;
+	default:
+		return -1;
+	}
+	if (*on && on[1U]) {
+		/* trailing garbage */
+		return -1;
+	}
+	*tgt = x < SIZE_MAX ? (size_t)x : SIZE_MAX;
+	return 0;
 }
 
 
@@ -248,12 +1010,16 @@ main(int argc, char *argv[])
 	char **fmt;
 	size_t nfmt;
 	zif_t fromz = NULL;
+	struct dt_io_fld_s fld;
 	int rc = 0;
 	struct sort_ctx_s sopt = {0U};
 
 	if (yuck_parse(argi, argc, argv)) {
 		rc = 1;
 		goto out;
+	} else if (dt_io_fld(&fld, argi->field_arg, argi->delimiter_arg) < 0) {
+		rc = 1;
+		goto out;
 	}
 	/* init and unescape sequences, maybe */
 	fmt = argi->input_format_args;
@@ -280,13 +1046,28 @@ Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
 		dt_set_base(base);
 	}
 
-	/* prepare a mini-argi for the sort invocation */
+	/* prepare a mini-argi for the sorter */
 	if (argi->reverse_flag) {
 		sopt.revp = 1U;
 	}
 	if (argi->unique_flag) {
 		sopt.unqp = 1U;
 	}
+	if (argi->buffer_size_arg) {
+		if (parse_size(&sopt.bufz, argi->buffer_size_arg) < 0) {
+			error("Error: invalid buffer size `%s'",
+			      argi->buffer_size_arg);
+			rc = 1;
+			goto clear;
+		}
+	} else {
+		/* half the physical memory, if we can find out */
+		(void)parse_size(&sopt.bufz, "50%");
+	}
+	if ((sopt.tmpd = argi->temporary_directory_arg) == NULL &&
+	    (sopt.tmpd = getenv("TMPDIR")) == NULL) {
+		sopt.tmpd = "/tmp";
+	}
 
 	{
 		/* process all files */
@@ -296,8 +1077,8 @@ Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
 		struct prln_ctx_s prln = {
 			.ndl = &ndlsoa,
 			.fromz = fromz,
+			.fld = fld,
 		};
-		pid_t cutp, sortp;
 
 		/* lest we overflow the stack */
 		if (nfmt >= nneedle) {
@@ -308,42 +1089,21 @@ Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
 		/* and now build the needles */
 		ndlsoa = build_needle(needle, nneedle, fmt, nfmt);
 
-		/* spawn children */
-		with (int ifd, ofd) {
-			if ((cutp = spawn_cut(&ifd)) < 0) {
-				goto ndl_free;
-			}
-			if ((sortp = spawn_sort(&ofd, ifd, sopt)) < 0) {
-				goto ndl_free;
-			}
-			prln.outfd = ofd;
-		}
-
-		for (size_t i = 0U; i < argi->nargs || i == 0U; i++) {
-			if (proc_file(prln, argi->args[i]) < 0) {
-				rc = 1;
-			}
-		}
-
-		/* indicate we're no longer writing to the sort helper */
-		close(prln.outfd);
-
-		/* wait for sort first */
-		with (int st) {
-			while (waitpid(sortp, &st, 0) != sortp);
-			if (WIFEXITED(st) && WEXITSTATUS(st)) {
-				rc = rc ?: WEXITSTATUS(st);
-			}
-		}
-		/* wait for cut then */
-		with (int st) {
-			while (waitpid(cutp, &st, 0) != cutp);
-			if (WIFEXITED(st) && WEXITSTATUS(st)) {
-				rc = rc ?: WEXITSTATUS(st);
-			}
+		__io_setlocking_bycaller(stdout);
+		if (argi->check_flag || argi->check_quiet_flag) {
+			/* 1 for disorder, 2 for trouble, like sort(1) */
+			rc = check_files(prln, sopt,
+					 argi->args, argi->nargs,
+					 argi->check_quiet_flag);
+			rc = rc < 0 ? 2 : rc;
+		} else if (argi->merge_flag) {
+			rc = merge_files(prln, sopt,
+					 argi->args, argi->nargs) < 0;
+		} else {
+			rc = sort_files(prln, sopt,
+					argi->args, argi->nargs) < 0;
 		}
 
-	ndl_free:
 		if (needle != __nstk) {
 			free(needle);
 		}
@@ -351,6 +1111,7 @@ Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
 
 clear:
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
@@ -0,0 +1,287 @@
+/*** dt-io-idx.c -- sidecar time indices for large files
+ *
+ * Copyright (C) 2010-2022 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of dateutils.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dt-core.h"
+#include "dt-io-idx.h"
+#include "nifty.h"
+
+#if !defined MAP_FAILED
+# define MAP_FAILED	((void*)-1)
+#endif	/* !MAP_FAILED */
+
+/* smallest read, reads grow with the lines */
+#define MIN_RDZ		(4096U)
+#define MAX_RDZ		(1024U * 1024U)
+
+static inline __attribute__((unused)) void*
+deconst(const void *cp)
+{
+	union {
+		const void *c;
+		void *p;
+	} tmp = {cp};
+	return tmp.p;
+}
+
+
+int64_t
+dt_idx_bkt(struct dt_dt_s d, unsigned int width)
+{
+/* buckets are counted from the daisy epoch, times of day are capped
+ * at 23:59:59 so leap seconds and 24:00:00 stay on their day */
+	int64_t s;
+
+	if (d.d.typ != DT_YMD) {
+		return DT_IDX_NOBKT;
+	} else if (dt_sandwich_only_d_p(d)) {
+		s = 0;
+	} else if (dt_sandwich_p(d) && d.t.typ == DT_HMS) {
+		s = (d.t.hms.h * 60 + d.t.hms.m) * 60 + d.t.hms.s;
+		s = s < SECS_PER_DAY ? s : SECS_PER_DAY - 1;
+	} else {
+		return DT_IDX_NOBKT;
+	}
+	s += (int64_t)dt_conv_to_daisy(d.d) * SECS_PER_DAY;
+	return s >= 0 ? s / width : (s - (width - 1)) / (int64_t)width;
+}
+
+struct dt_dt_s
+dt_idx_bkt_dt(int64_t bkt, unsigned int width)
+{
+	const int64_t s = bkt * width;
+	int64_t dd = s / SECS_PER_DAY;
+	int64_t sod = s % SECS_PER_DAY;
+	struct dt_dt_s res = {DT_UNK};
+
+	if (sod < 0) {
+		dd--;
+		sod += SECS_PER_DAY;
+	}
+	res.d.typ = DT_DAISY;
+	res.d.daisy = (dt_daisy_t)dd;
+	res.d = dt_dconv(DT_YMD, res.d);
+	res.t.hms.h = sod / 3600;
+	res.t.hms.m = sod / 60 % 60;
+	res.t.hms.s = sod % 60;
+	dt_make_sandwich(&res, DT_YMD, DT_HMS);
+	return res;
+}
+
+off_t
+dt_idx_next_line(int fd, off_t off)
+{
+	char buf[MIN_RDZ];
+	ssize_t nrd;
+
+	if (off <= 0) {
+		return 0;
+	}
+	/* the line before OFF might end right before OFF */
+	for (off--; (nrd = pread(fd, buf, sizeof(buf), off)) > 0; off += nrd) {
+		const char *p;
+
+		if ((p = memchr(buf, '\n', nrd)) != NULL) {
+			return off + (p - buf) + 1;
+		}
+	}
+	return -1;
+}
+
+int
+dt_idx_scan(int fd, off_t lo, off_t hi, dt_idx_line_f fn, void *clo)
+{
+/* read the lines in bits of at least MIN_RDZ bytes, or more if there's
+ * more to go, no more than MAX_RDZ though unless lines are longer */
+	size_t bsz = MIN_RDZ;
+	char *buf;
+	size_t bno = 0U;
+	/* file offset of BUF */
+	off_t boff = lo;
+	int rc = 0;
+
+	if (UNLIKELY((buf = malloc(bsz)) == NULL)) {
+		return -1;
+	}
+	while (boff < hi) {
+		size_t rdz = hi - boff > MAX_RDZ ? MAX_RDZ : hi - boff;
+		char *bp, *ep;
+		ssize_t nrd;
+
+		rdz = rdz > MIN_RDZ ? rdz : MIN_RDZ;
+		/* keep room for the \0 of an unterminated last line */
+		if (bno + rdz + 1U > bsz) {
+			size_t nu = bsz;
+			char *tmp;
+
+			while ((nu *= 2U) < bno + rdz + 1U);
+			if (UNLIKELY((tmp = realloc(buf, nu)) == NULL)) {
+				rc = -1;
+				break;
+			}
+			buf = tmp;
+			bsz = nu;
+		}
+		if ((nrd = pread(fd, buf + bno, rdz, boff + bno)) < 0) {
+			rc = -1;
+			break;
+		}
+		ep = buf + (bno += nrd);
+		for (bp = buf; bp < ep && boff + (bp - buf) < hi;) {
+			char *lp = memchr(bp, '\n', ep - bp);
+			size_t llen;
+
+			if (lp == NULL && nrd > 0) {
+				/* incomplete line, read more */
+				break;
+			} else if (lp == NULL) {
+				/* last line, unterminated */
+				lp = ep;
+			}
+			llen = lp - bp;
+			if (llen && bp[llen - 1U] == '\r') {
+				llen--;
+			}
+			bp[llen] = '\0';
+			rc |= fn(clo, bp, llen, boff + (bp - buf));
+			bp = lp + 1;
+		}
+		if (nrd == 0 || bp >= ep) {
+			/* all done or we need a fresh buffer */
+			boff += bp - buf;
+			bno = 0U;
+			if (nrd == 0) {
+				break;
+			}
+			continue;
+		}
+		/* move the partial line to the front */
+		memmove(buf, bp, ep - bp);
+		bno = ep - bp;
+		boff += bp - buf;
+	}
+	free(buf);
+	return rc;
+}
+
+static uint64_t
+__sig_str(uint64_t h, const char *s)
+{
+/* fold S into FNV-1a hash H, NULL and "" must come out differently */
+	if (s == NULL) {
+		return (h ^ 0xffU) * 0x100000001b3ULL;
+	}
+	do {
+		h = (h ^ (unsigned char)*s) * 0x100000001b3ULL;
+	} while (*s++);
+	return h;
+}
+
+uint64_t
+dt_idx_sig(const char *fromz, const char *floc, const char *base,
+	   const char *fld, const char *dlm, char *const *fmt, size_t nfmt)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	h = __sig_str(h, fromz);
+	h = __sig_str(h, floc);
+	h = __sig_str(h, base);
+	h = __sig_str(h, fld);
+	h = __sig_str(h, dlm);
+	for (size_t i = 0U; i < nfmt; i++) {
+		h = __sig_str(h, fmt[i]);
+	}
+	return h;
+}
+
+const struct dt_idx_hdr_s*
+dt_idx_open(const char *fn, int fd, uint64_t sig)
+{
+	const struct dt_idx_hdr_s *res;
+	struct stat st, ist;
+	int ifd;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		return NULL;
+	} else if ((ifd = open(fn, O_RDONLY)) < 0) {
+		return NULL;
+	} else if (fstat(ifd, &ist) < 0 ||
+		   (size_t)ist.st_size < sizeof(*res)) {
+		close(ifd);
+		return NULL;
+	}
+	res = mmap(NULL, ist.st_size, PROT_READ, MAP_SHARED, ifd, 0);
+	close(ifd);
+	if (res == MAP_FAILED) {
+		return NULL;
+	} else if (memcmp(res->magic, DT_IDX_MAGIC, sizeof(res->magic)) ||
+		   res->ver != DT_IDX_VERSION || !res->width ||
+		   (ist.st_size - sizeof(*res)) % sizeof(struct dt_idx_ent_s) ||
+		   res->nent != (ist.st_size - sizeof(*res)) /
+		   sizeof(struct dt_idx_ent_s)) {
+		/* not an index, or not one of ours */
+		goto unmap;
+	} else if (res->fsz != (uint64_t)st.st_size ||
+		   res->mtim != (int64_t)st.st_mtime) {
+		/* stale */
+		goto unmap;
+	} else if (res->sig != sig) {
+		/* built for other formats, fields or zones */
+		goto unmap;
+	}
+	return res;
+unmap:
+	munmap(deconst(res), ist.st_size);
+	return NULL;
+}
+
+void
+dt_idx_close(const struct dt_idx_hdr_s *hdr)
+{
+	munmap(deconst(hdr),
+	       sizeof(*hdr) + hdr->nent * sizeof(struct dt_idx_ent_s));
+	return;
+}
+
+/* dt-io-idx.c ends here */
@@ -0,0 +1,133 @@
+/*** dt-io-idx.h -- sidecar time indices for large files
+ *
+ * Copyright (C) 2011-2022 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of dateutils.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_dt_io_idx_h_
+#define INCLUDED_dt_io_idx_h_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "dt-core.h"
+
+/**
+ * Index files consist of a header and NENT entries, in host byte order
+ * and laid out so they can be mmap()ed and used as is.
+ * An entry states that every line with a date/time in buckets BLO to BHI
+ * starts somewhere in [LO, HI) of the indexed file, though not all lines
+ * in [LO, HI) need to have such date/times.  Buckets are WIDTH seconds
+ * wide, a bucket may appear in several entries.  Entries are sorted by
+ * BLO, lines whose date/times fit no bucket (like times without dates)
+ * go to entries for bucket DT_IDX_NOBKT which sort before all others. */
+#define DT_IDX_MAGIC	"DTIDX\0\0"
+#define DT_IDX_VERSION	(2U)
+#define DT_IDX_NOBKT	(INT64_MIN)
+
+struct dt_idx_hdr_s {
+	char magic[8U];
+	uint32_t ver;
+	/* bucket width in seconds */
+	uint32_t width;
+	/* size and modification time of the indexed file */
+	uint64_t fsz;
+	int64_t mtim;
+	/* signature of the settings the index was built with */
+	uint64_t sig;
+	/* number of entries following this header */
+	uint64_t nent;
+};
+
+struct dt_idx_ent_s {
+	int64_t blo;
+	int64_t bhi;
+	uint64_t lo;
+	uint64_t hi;
+};
+
+/**
+ * Line processor, CLO is the caller's closure, LINE is \0-terminated
+ * at LLEN and may be modified, OFF is LINE's offset in the file. */
+typedef int(*dt_idx_line_f)(void *clo, char *line, size_t llen, off_t off);
+
+/**
+ * Return the bucket of D for buckets of WIDTH seconds. */
+extern int64_t dt_idx_bkt(struct dt_dt_s d, unsigned int width);
+
+/**
+ * Return the first date/time of bucket BKT, for buckets of WIDTH
+ * seconds. */
+extern struct dt_dt_s dt_idx_bkt_dt(int64_t bkt, unsigned int width);
+
+/**
+ * Return the offset of the first line that starts at or after OFF in FD,
+ * or -1 if there's none. */
+extern off_t dt_idx_next_line(int fd, off_t off);
+
+/**
+ * Feed the lines of FD that start in [LO, HI) to FN, along with CLO.
+ * LO must be the start of a line.
+ * Return the bitwise or of FN's return values, or -1 on read errors. */
+extern int
+dt_idx_scan(int fd, off_t lo, off_t hi, dt_idx_line_f fn, void *clo);
+
+/**
+ * Return the signature of the settings that determine which date/times
+ * are found on a line, i.e. the --from-zone, --from-locale and --base
+ * arguments FROMZ, FLOC and BASE, the -k and -d arguments FLD and DLM
+ * and the NFMT input formats FMT, any of which may be NULL. */
+extern uint64_t
+dt_idx_sig(const char *fromz, const char *floc, const char *base,
+	   const char *fld, const char *dlm, char *const *fmt, size_t nfmt);
+
+/**
+ * Map the index file FN and check that it belongs to the file open
+ * as FD and has been built with the settings of signature SIG,
+ * return NULL if it doesn't or on error. */
+extern const struct dt_idx_hdr_s*
+dt_idx_open(const char *fn, int fd, uint64_t sig);
+
+/**
+ * Unmap index HDR. */
+extern void dt_idx_close(const struct dt_idx_hdr_s *hdr);
+
+/**
+ * Return the entries of index HDR. */
+static inline const struct dt_idx_ent_s*
+dt_idx_ents(const struct dt_idx_hdr_s *hdr)
+{
+	return (const struct dt_idx_ent_s*)(hdr + 1U);
+}
+
+#endif	/* INCLUDED_dt_io_idx_h_ */
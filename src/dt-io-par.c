@@ -0,0 +1,439 @@
+/*** dt-io-par.c -- parallel line processing with ordered output
+ *
+ * Copyright (C) 2010-2022 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of dateutils.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#if defined HAVE_PTHREAD_H
+# include <pthread.h>
+#endif	/* HAVE_PTHREAD_H */
+#include "dt-io.h"
+#include "dt-io-par.h"
+#include "prchunk.h"
+#include "nifty.h"
+
+/* lines are handed to the workers in jobs of about this many bytes */
+#define JOBZ		(64U * 1024U)
+/* number of jobs in flight per worker */
+#define NJOB_PER_WRK	(4U)
+
+
+int
+dt_io_par_njob(const char *spec)
+{
+	char *on;
+	long int n;
+
+	if (spec == NULL) {
+		return 1;
+	} else if ((n = strtol(spec, &on, 10)) < 0 || *on || on == spec) {
+		return -1;
+	} else if (n == 0) {
+#if defined _SC_NPROCESSORS_ONLN
+		n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif	/* _SC_NPROCESSORS_ONLN */
+		return n > 0 ? (int)n : 1;
+	}
+	/* there's no point in more threads than that */
+	return n < 1024 ? (int)n : 1024;
+}
+
+static int
+dt_io_ser(int fd, dt_io_par_f fn, void *clo)
+{
+/* the single-threaded version, lines go straight to FN */
+	void *pctx;
+	int rc = 0;
+
+	if ((pctx = init_prchunk_ro(fd)) == NULL) {
+		return -1;
+	}
+	while (prchunk_fill(pctx) >= 0) {
+		for (char *line; prchunk_haslinep(pctx);) {
+			size_t llen = prchunk_getline_rw(pctx, &line);
+
+			if (UNLIKELY(line == NULL)) {
+				rc = -1;
+				goto out;
+			}
+			rc |= fn(clo, stdout, line, llen);
+		}
+	}
+out:
+	free_prchunk(pctx);
+	return rc;
+}
+
+#if defined HAVE_PTHREAD_H
+struct job_s {
+	/* the lines, either copied to BUF, each one \0-terminated, or,
+	 * if MAP is set, the originals at MAP in the read-only mapping */
+	char *buf;
+	size_t bsz;
+	/* bytes used in BUF, or spanned at MAP */
+	size_t bno;
+	const char *map;
+	struct {
+		size_t off;
+		size_t len;
+	} *lin;
+	size_t zlin;
+	size_t nlin;
+
+	/* FN's output, this is a memstream over OBUF */
+	FILE *out;
+	char *obuf;
+	size_t osz;
+	size_t olen;
+	/* FN's diagnostics, a memstream over EBUF */
+	FILE *err;
+	char *ebuf;
+	size_t esz;
+	size_t elen;
+
+	/* FN's return values or'd together */
+	int rc;
+	/* set by the worker when it's done with this job */
+	bool donep;
+};
+
+struct par_s {
+	dt_io_par_f fn;
+	struct job_s *job;
+	size_t njob;
+
+	pthread_mutex_t mtx;
+	/* signalled upon submission of a new job, or at the end */
+	pthread_cond_t work;
+	/* signalled when a worker finishes a job */
+	pthread_cond_t done;
+	/* jobs are taken in the order they have been submitted */
+	size_t nsub;
+	size_t ntak;
+	bool eofp;
+};
+
+struct wrk_s {
+	struct par_s *par;
+	void *clo;
+	pthread_t thr;
+	/* writable copy of the current line of mapped jobs */
+	char *lbuf;
+	size_t lbsz;
+};
+
+static int
+push_line(struct job_s *j, const char *line, size_t llen, bool mapp)
+{
+/* append LINE to J, lines of mapped files are referenced in place,
+ * they're consecutive so a job covers one stretch of the mapping */
+	if (UNLIKELY(j->nlin >= j->zlin)) {
+		size_t nu = j->zlin ? 2U * j->zlin : 4096U;
+		void *tmp;
+
+		if (UNLIKELY((tmp = realloc(j->lin, nu * sizeof(*j->lin))) == NULL)) {
+			return -1;
+		}
+		j->lin = tmp;
+		j->zlin = nu;
+	}
+	if (mapp) {
+		if (!j->nlin) {
+			j->map = line;
+		}
+		j->lin[j->nlin].off = line - j->map;
+		j->lin[j->nlin].len = llen;
+		j->nlin++;
+		j->bno = line - j->map + llen + 1U;
+		return 0;
+	} else if (UNLIKELY(j->bno + llen + 1U > j->bsz)) {
+		size_t nu = j->bsz ? j->bsz : 2U * JOBZ;
+		char *tmp;
+
+		while (nu < j->bno + llen + 1U) {
+			nu *= 2U;
+		}
+		if (UNLIKELY((tmp = realloc(j->buf, nu)) == NULL)) {
+			return -1;
+		}
+		j->buf = tmp;
+		j->bsz = nu;
+	}
+	memcpy(j->buf + j->bno, line, llen);
+	j->buf[j->bno + llen] = '\0';
+	j->lin[j->nlin].off = j->bno;
+	j->lin[j->nlin].len = llen;
+	j->nlin++;
+	j->bno += llen + 1U;
+	return 0;
+}
+
+static char*
+wrk_line(struct wrk_s *w, const char *line, size_t llen)
+{
+/* copy LINE to W's line buffer and \0-terminate it there */
+	if (UNLIKELY(llen >= w->lbsz)) {
+		size_t nu = w->lbsz ? w->lbsz : 4096U;
+		char *tmp;
+
+		while (nu <= llen) {
+			nu *= 2U;
+		}
+		if (UNLIKELY((tmp = realloc(w->lbuf, nu)) == NULL)) {
+			return NULL;
+		}
+		w->lbuf = tmp;
+		w->lbsz = nu;
+	}
+	memcpy(w->lbuf, line, llen);
+	w->lbuf[llen] = '\0';
+	return w->lbuf;
+}
+
+static void*
+work(void *arg)
+{
+	struct wrk_s *w = arg;
+	struct par_s *p = w->par;
+
+	pthread_mutex_lock(&p->mtx);
+	while (1) {
+		struct job_s *j;
+
+		while (p->ntak >= p->nsub && !p->eofp) {
+			pthread_cond_wait(&p->work, &p->mtx);
+		}
+		if (p->ntak >= p->nsub) {
+			/* no more jobs and none to come */
+			break;
+		}
+		j = p->job + p->ntak++ % p->njob;
+		pthread_mutex_unlock(&p->mtx);
+
+		/* overwrite the output of this slot's previous job */
+		fseeko(j->out, 0, SEEK_SET);
+		fseeko(j->err, 0, SEEK_SET);
+		dt_io_errf = j->err;
+		j->rc = 0;
+		for (size_t i = 0U; i < j->nlin; i++) {
+			const size_t llen = j->lin[i].len;
+			char *line = j->map == NULL
+				? j->buf + j->lin[i].off
+				: wrk_line(w, j->map + j->lin[i].off, llen);
+
+			if (UNLIKELY(line == NULL)) {
+				j->rc = -1;
+				break;
+			}
+			j->rc |= p->fn(w->clo, j->out, line, llen);
+		}
+		fflush(j->out);
+		j->olen = ftello(j->out);
+		fflush(j->err);
+		j->elen = ftello(j->err);
+
+		pthread_mutex_lock(&p->mtx);
+		j->donep = true;
+		pthread_cond_signal(&p->done);
+	}
+	pthread_mutex_unlock(&p->mtx);
+	return NULL;
+}
+
+static void
+submit(struct par_s *p)
+{
+	pthread_mutex_lock(&p->mtx);
+	p->nsub++;
+	pthread_cond_signal(&p->work);
+	pthread_mutex_unlock(&p->mtx);
+	return;
+}
+
+static int
+flush(struct par_s *p, struct job_s *j)
+{
+/* wait for J to be finished, write its output and recycle it */
+	pthread_mutex_lock(&p->mtx);
+	while (!j->donep) {
+		pthread_cond_wait(&p->done, &p->mtx);
+	}
+	pthread_mutex_unlock(&p->mtx);
+
+	if (j->elen) {
+		fwrite(j->ebuf, 1U, j->elen, stderr);
+	}
+	__io_write(j->obuf, j->olen, stdout);
+	j->donep = false;
+	j->bno = 0U;
+	j->map = NULL;
+	j->nlin = 0U;
+	return j->rc;
+}
+
+static int
+dt_io_par_mt(int fd, dt_io_par_f fn, void *const clo[], size_t nwrk)
+{
+	struct par_s p = {
+		.fn = fn,
+		.mtx = PTHREAD_MUTEX_INITIALIZER,
+		.work = PTHREAD_COND_INITIALIZER,
+		.done = PTHREAD_COND_INITIALIZER,
+	};
+	struct wrk_s *w;
+	size_t nthr = 0U;
+	size_t seq = 0U;
+	struct job_s *j = NULL;
+	void *pctx = NULL;
+	bool mapp;
+	int rc = 0;
+
+	p.njob = NJOB_PER_WRK * nwrk;
+	if (UNLIKELY((p.job = calloc(p.njob, sizeof(*p.job))) == NULL)) {
+		return -1;
+	} else if (UNLIKELY((w = calloc(nwrk, sizeof(*w))) == NULL)) {
+		free(p.job);
+		return -1;
+	}
+	for (size_t i = 0U; i < p.njob; i++) {
+		struct job_s *k = p.job + i;
+
+		if (UNLIKELY((k->out = open_memstream(&k->obuf, &k->osz)) == NULL)) {
+			rc = -1;
+			goto clean;
+		} else if (UNLIKELY((k->err = open_memstream(
+					     &k->ebuf, &k->esz)) == NULL)) {
+			rc = -1;
+			goto clean;
+		}
+		/* one thread at a time, handed over under the mutex */
+		__io_setlocking_bycaller(k->out);
+		__io_setlocking_bycaller(k->err);
+	}
+	for (; nthr < nwrk; nthr++) {
+		w[nthr].par = &p;
+		w[nthr].clo = clo[nthr];
+		if (pthread_create(&w[nthr].thr, NULL, work, w + nthr)) {
+			break;
+		}
+	}
+	if (UNLIKELY(!nthr)) {
+		/* do it ourselves then */
+		rc = dt_io_ser(fd, fn, *clo);
+		goto clean;
+	} else if ((pctx = init_prchunk_ro(fd)) == NULL) {
+		rc = -1;
+		goto drain;
+	}
+	/* mapped lines stay put, jobs needn't copy them then */
+	mapp = prchunk_mapped_p(pctx);
+
+	while (prchunk_fill(pctx) >= 0) {
+		for (char *line; prchunk_haslinep(pctx);) {
+			size_t llen = prchunk_getline(pctx, &line);
+
+			if (j == NULL) {
+				/* next slot, its previous job must be out */
+				j = p.job + seq % p.njob;
+				if (seq >= p.njob) {
+					rc |= flush(&p, j);
+				}
+			}
+			if (UNLIKELY(push_line(j, line, llen, mapp) < 0)) {
+				rc = -1;
+				goto drain;
+			} else if (j->bno >= JOBZ) {
+				submit(&p);
+				seq++;
+				j = NULL;
+			}
+		}
+	}
+	if (j != NULL) {
+		/* the last, partially filled job */
+		submit(&p);
+		seq++;
+	}
+	for (size_t s = seq > p.njob ? seq - p.njob : 0U; s < seq; s++) {
+		rc |= flush(&p, p.job + s % p.njob);
+	}
+drain:
+	pthread_mutex_lock(&p.mtx);
+	p.eofp = true;
+	pthread_cond_broadcast(&p.work);
+	pthread_mutex_unlock(&p.mtx);
+	for (size_t i = 0U; i < nthr; i++) {
+		pthread_join(w[i].thr, NULL);
+		free(w[i].lbuf);
+	}
+	if (pctx != NULL) {
+		free_prchunk(pctx);
+	}
+clean:
+	for (size_t i = 0U; i < p.njob; i++) {
+		if (p.job[i].out != NULL) {
+			fclose(p.job[i].out);
+		}
+		if (p.job[i].err != NULL) {
+			fclose(p.job[i].err);
+		}
+		free(p.job[i].obuf);
+		free(p.job[i].ebuf);
+		free(p.job[i].buf);
+		free(p.job[i].lin);
+	}
+	free(p.job);
+	free(w);
+	return rc;
+}
+#endif	/* HAVE_PTHREAD_H */
+
+int
+dt_io_par(int fd, dt_io_par_f fn, void *const clo[], size_t njob)
+{
+#if defined HAVE_PTHREAD_H
+	if (njob > 1U) {
+		return dt_io_par_mt(fd, fn, clo, njob);
+	}
+#endif	/* HAVE_PTHREAD_H */
+	return dt_io_ser(fd, fn, *clo);
+}
+
+/* dt-io-par.c ends here */
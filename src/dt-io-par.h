@@ -0,0 +1,58 @@
+/*** dt-io-par.h -- parallel line processing with ordered output
+ *
+ * Copyright (C) 2011-2022 Sebastian Freundt
+ *
+ * Author:  Sebastian Freundt <freundt@ga-group.nl>
+ *
+ * This file is part of dateutils.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the author nor the names of any contributors
+ *    may be used to endorse or promote products derived from this
+ *    software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***/
+#if !defined INCLUDED_dt_io_par_h_
+#define INCLUDED_dt_io_par_h_
+
+#include <stdio.h>
+
+/**
+ * Line processor, CLO is the caller's closure, LINE is \0-terminated
+ * at LLEN and may be modified, output is to go to OUT. */
+typedef int(*dt_io_par_f)(void *clo, FILE *out, char *line, size_t llen);
+
+/**
+ * Return the number of jobs requested by SPEC (the argument to -j),
+ * 0 meaning one job per CPU, or -1 if SPEC is no number. */
+extern int dt_io_par_njob(const char *spec);
+
+/**
+ * Feed lines from FD to FN, the i-th of NJOB threads passing CLO[i].
+ * Whatever FN writes to its OUT stream ends up on stdout in input order.
+ * Return the bitwise or of FN's return values. */
+extern int dt_io_par(int fd, dt_io_par_f fn, void *const clo[], size_t njob);
+
+#endif	/* INCLUDED_dt_io_par_h_ */
@@ -35,17 +35,58 @@
 
 
 /* our own perror() implementation */
+__thread FILE *dt_io_errf;
+
+static void
+__verror(int eno, const char *fmt, va_list vap)
+{
+/* format the message as a whole, i.e. prog: message[: strerror]\n,
+ * and write it in one go so that messages from concurrent jobs
+ * don't get torn */
+	const char *es = eno ? strerror(eno) : "";
+	const size_t pz = strlen(prog);
+	const size_t ez = strlen(es);
+	char buf[512U];
+	char *bp = buf;
+	size_t bz = sizeof(buf);
+	va_list cap;
+	size_t n;
+	int mz;
+
+	va_copy(cap, vap);
+	mz = vsnprintf(NULL, 0U, fmt, cap);
+	va_end(cap);
+	if (UNLIKELY(mz < 0)) {
+		return;
+	} else if (pz + 2U + mz + 2U + ez + 1U >= bz &&
+		   (bp = malloc(bz = pz + 2U + mz + 2U + ez + 2U)) == NULL) {
+		return;
+	}
+	memcpy(bp, prog, pz);
+	memcpy(bp + pz, ": ", 2U);
+	n = pz + 2U;
+	n += vsnprintf(bp + n, bz - n, fmt, vap);
+	if (eno) {
+		memcpy(bp + n, ": ", 2U);
+		memcpy(bp + n + 2U, es, ez);
+		n += 2U + ez;
+	}
+	bp[n++] = '\n';
+	fwrite(bp, 1U, n, dt_io_errf ?: stderr);
+	if (bp != buf) {
+		free(bp);
+	}
+	return;
+}
+
 void
 __attribute__((format(printf, 1, 2)))
 error(const char *fmt, ...)
 {
 	va_list vap;
 	va_start(vap, fmt);
-	fputs(prog, stderr);
-	fputs(": ", stderr);
-	vfprintf(stderr, fmt, vap);
+	__verror(0, fmt, vap);
 	va_end(vap);
-	fputc('\n', stderr);
 	return;
 }
 
@@ -53,22 +94,15 @@ void
 __attribute__((format(printf, 1, 2)))
 serror(const char *fmt, ...)
 {
+	const int eno = errno;
 	va_list vap;
 	va_start(vap, fmt);
-	fputs(prog, stderr);
-	fputs(": ", stderr);
-	vfprintf(stderr, fmt, vap);
+	__verror(eno, fmt, vap);
 	va_end(vap);
-	if (errno) {
-		fputc(':', stderr);
-		fputc(' ', stderr);
-		fputs(strerror(errno), stderr);
-	}
-	fputc('\n', stderr);
 	return;
 }
 
-
+
 #include "strpdt-special.c"
 
 /* coverity[-tainted_data_sink: arg-0] */
@@ -89,6 +123,364 @@ dt_io_strpdt_special(const char *str)
 	return STRPDT_UNK;
 }
 
+/* compiled input and output formats, keyed by format string */
+static struct alist_s fmtprogs[1U];
+static struct alist_s strfprogs[1U];
+/* output program for the NULL format */
+static dt_fmtprog_t strfprog_dflt;
+
+/* format dispatch, for every position and byte the set of formats
+ * (by index, only the first 32) that could possibly match there,
+ * this is a flattened trie over all the formats' shapes */
+struct dt_io_fmtsel_s {
+	/* dispatcher for the previously built format list */
+	struct dt_io_fmtsel_s *next;
+	char *const *fmt;
+	size_t nfmt;
+	uint32_t cand[DT_SHAPE_LEN][256U];
+	/* per format, one more for the misses */
+	struct {
+		dt_fmtprog_t prog;
+		size_t hits;
+		/* whether no earlier format can match whatever this one
+		 * matches, so it can be tried out of order */
+		bool lonep;
+	} f[];
+};
+/* one dispatcher per format list, most recently built first */
+static struct dt_io_fmtsel_s *fmtsel;
+/* the format that matched most recently and its list, per thread */
+static __thread const struct dt_io_fmtsel_s *hotsel;
+static __thread size_t fmthot;
+/* whether to keep the tallies for dt_io_fmtstats() */
+static bool statsp;
+
+dt_fmtprog_t
+dt_io_fmtprog(const char *fmt)
+{
+/* return the compiled program for FMT, compile it if need be,
+ * or NULL if that's not possible */
+	dt_fmtprog_t res;
+
+	if (fmt == NULL) {
+		/* standard format, never fails */
+		return dt_strpdt_compile(NULL);
+	} else if ((res = alist_assoc(fmtprogs, fmt)) != NULL) {
+		return res;
+	} else if (UNLIKELY((res = dt_strpdt_compile(fmt)) == NULL)) {
+		serror("Error: cannot compile input format `%s'", fmt);
+		return NULL;
+	}
+	/* cache the instance */
+	alist_put(fmtprogs, fmt, res);
+	return res;
+}
+
+dt_fmtprog_t
+dt_io_strfprog(const char *fmt)
+{
+/* return the compiled output program for FMT, compile it if need be */
+	dt_fmtprog_t res;
+
+	if (fmt == NULL) {
+		if (UNLIKELY(strfprog_dflt == NULL)) {
+			strfprog_dflt = dt_strfdt_compile(NULL);
+		}
+		return strfprog_dflt;
+	} else if ((res = alist_assoc(strfprogs, fmt)) != NULL) {
+		return res;
+	} else if ((res = dt_strfdt_compile(fmt)) != NULL) {
+		/* cache the instance */
+		alist_put(strfprogs, fmt, res);
+	}
+	return res;
+}
+
+/* byte classes for shape signatures, all bytes not listed are in class
+ * SHCLS_OTHER, entries are stored xor'd with it so they can default to 0 */
+#define SHCLS_OTHER	(0x80U)
+static const uint8_t shcls_x[256U] = {
+	['0' ... '9'] = 0x01U ^ SHCLS_OTHER,
+	['A' ... 'Z'] = 0x02U ^ SHCLS_OTHER,
+	['a' ... 'z'] = 0x02U ^ SHCLS_OTHER,
+	[' '] = 0x04U ^ SHCLS_OTHER,
+	['\t'] = 0x04U ^ SHCLS_OTHER,
+	['-'] = 0x08U ^ SHCLS_OTHER,
+	[':'] = 0x10U ^ SHCLS_OTHER,
+	['/'] = 0x20U ^ SHCLS_OTHER,
+	['.'] = 0x40U ^ SHCLS_OTHER,
+};
+/* candidate offsets tried and rejected by their shape signature */
+static size_t nsig_try;
+static size_t nsig_rej;
+
+static inline uint8_t
+shcls(unsigned char c)
+{
+	return (uint8_t)(shcls_x[c] ^ SHCLS_OTHER);
+}
+
+static inline void
+dt_io_tally(size_t *cnt)
+{
+/* counters may be shared by several threads */
+	if (UNLIKELY(statsp)) {
+		__atomic_fetch_add(cnt, 1U, __ATOMIC_RELAXED);
+	}
+	return;
+}
+
+static uint64_t
+dt_io_shape_sig(dt_fmtprog_t fp)
+{
+/* condense FP's shape into 8 bytes of byte classes, one per position */
+	struct dt_shape_s sh;
+	uint64_t res = 0U;
+
+	dt_strpdt_shape(&sh, fp);
+	for (size_t j = 0U; j < sizeof(res); j++) {
+		uint64_t cls = 0U;
+
+		if (j >= sh.len) {
+			cls = 0xffU;
+		} else for (unsigned int c = 0U; c < 256U; c++) {
+			if (sh.set[j][c / 64U] >> (c % 64U) & 1U) {
+				cls |= shcls((unsigned char)c);
+			}
+		}
+		res |= cls << (j * 8U);
+	}
+	return res;
+}
+
+static inline bool
+dt_io_sigp(uint64_t sig, const char *q, const char *zp)
+{
+/* whether the string at Q (ending at ZP) could possibly fit SIG */
+	uint64_t cls = 0U;
+
+	for (size_t j = 0U; j < sizeof(cls) && q + j < zp; j++) {
+		cls |= (uint64_t)shcls((unsigned char)q[j]) << (j * 8U);
+	}
+	dt_io_tally(&nsig_try);
+	if (cls & ~sig) {
+		dt_io_tally(&nsig_rej);
+		return false;
+	}
+	return true;
+}
+
+static inline void
+dt_io_fmthit(struct dt_io_fmtsel_s *sel, size_t i)
+{
+/* count a hit for format I of SEL's list,
+ * or a miss if I is the number of formats */
+	if (LIKELY(sel != NULL) && i <= sel->nfmt) {
+		dt_io_tally(&sel->f[i].hits);
+	}
+	return;
+}
+
+static bool
+dt_io_shape_disjp(const struct dt_shape_s *a, const struct dt_shape_s *b)
+{
+/* whether no string can fit both shapes A and B */
+	for (size_t j = 0U; j < a->len && j < b->len; j++) {
+		uint64_t x = 0U;
+
+		for (size_t w = 0U; w < countof(a->set[j]); w++) {
+			x |= a->set[j][w] & b->set[j][w];
+		}
+		if (!x) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static struct dt_io_fmtsel_s*
+dt_io_fmtsel(char *const *fmt, size_t nfmt)
+{
+/* return the dispatch table for formats FMT, build it if need be */
+	struct dt_io_fmtsel_s *sel;
+	struct dt_shape_s *sh;
+
+	for (sel = fmtsel; sel != NULL; sel = sel->next) {
+		if (LIKELY(sel->fmt == fmt && sel->nfmt == nfmt)) {
+			return sel;
+		}
+	}
+	sel = malloc(sizeof(*sel) + (nfmt + 1U) * sizeof(*sel->f));
+	if (UNLIKELY(sel == NULL)) {
+		return NULL;
+	} else if (UNLIKELY((sh = malloc(nfmt * sizeof(*sh))) == NULL)) {
+		free(sel);
+		return NULL;
+	}
+	memset(sel->cand, 0, sizeof(sel->cand));
+	memset(sel->f, 0, (nfmt + 1U) * sizeof(*sel->f));
+	sel->fmt = fmt;
+	sel->nfmt = nfmt;
+	for (size_t i = 0U; i < nfmt; i++) {
+		if (UNLIKELY((sel->f[i].prog = dt_io_fmtprog(fmt[i])) == NULL)) {
+			free(sh);
+			free(sel);
+			return NULL;
+		}
+		dt_strpdt_shape(sh + i, sel->f[i].prog);
+
+		sel->f[i].lonep = true;
+		for (size_t k = 0U; k < i; k++) {
+			if (!dt_io_shape_disjp(sh + k, sh + i)) {
+				sel->f[i].lonep = false;
+				break;
+			}
+		}
+		if (i >= 32U) {
+			/* formats beyond the 32nd are always tried */
+			continue;
+		}
+		for (size_t j = 0U; j < DT_SHAPE_LEN; j++) {
+			for (unsigned int c = 0U; c < 256U; c++) {
+				if (j >= sh[i].len ||
+				    sh[i].set[j][c / 64U] >> (c % 64U) & 1U) {
+					sel->cand[j][c] |= 1U << i;
+				}
+			}
+		}
+	}
+	free(sh);
+	/* keep the others, their hit counts are still referenced */
+	sel->next = fmtsel;
+	return fmtsel = sel;
+}
+
+static uint32_t
+dt_io_fmtcand(const struct dt_io_fmtsel_s *sel, const char *str)
+{
+/* return the set of formats among the first 32 that could match STR,
+ * in one pass over STR's leading bytes */
+	uint32_t res = UINT32_MAX;
+
+	if (sel->nfmt <= 1U) {
+		return res;
+	}
+	for (size_t j = 0U; j < DT_SHAPE_LEN && res; j++) {
+		res &= sel->cand[j][(unsigned char)str[j]];
+		if (!str[j]) {
+			break;
+		}
+	}
+	return res;
+}
+
+static struct dt_dt_s
+dt_io_strpdt_fmts(const char *str, char *const *fmt, size_t nfmt, char **ep)
+{
+/* the first format in FMT that reads STR wins, however the most recent
+ * winner is tried first if that can't possibly change the outcome */
+	struct dt_io_fmtsel_s *sel;
+	struct dt_dt_s res = {DT_UNK};
+	size_t hot = nfmt;
+	uint32_t cand;
+
+	if (UNLIKELY((sel = dt_io_fmtsel(fmt, nfmt)) == NULL)) {
+		/* do it the old-fashioned way, uncompiled */
+		for (size_t i = 0U; i < nfmt; i++) {
+			if (!dt_unk_p(res = dt_strpdt(str, fmt[i], ep))) {
+				break;
+			}
+		}
+		return res;
+	}
+	if (LIKELY(hotsel == sel) && sel->f[fmthot].lonep) {
+		hot = fmthot;
+		if (!dt_unk_p(res = dt_strpdt_prog(sel->f[hot].prog, str, ep))) {
+			dt_io_fmthit(sel, hot);
+			return res;
+		}
+	}
+	cand = dt_io_fmtcand(sel, str);
+	for (size_t i = 0U; i < nfmt; i++) {
+		if (i < 32U && !(cand >> i & 1U) || i == hot) {
+			/* can't possibly match, or tried already */
+			continue;
+		} else if (!dt_unk_p(res = dt_strpdt_prog(sel->f[i].prog, str, ep))) {
+			dt_io_fmthit(sel, i);
+			hotsel = sel;
+			fmthot = i;
+			return res;
+		}
+	}
+	dt_io_fmthit(sel, nfmt);
+	if (ep != NULL) {
+		/* as if all formats had been tried */
+		*ep = (char*)str;
+	}
+	return res;
+}
+
+void
+dt_io_fmtstats_on(void)
+{
+/* start counting hits and misses */
+	statsp = true;
+	return;
+}
+
+static void
+dt_io_fmtsel_stats(FILE *whither, const struct dt_io_fmtsel_s *sel)
+{
+/* print hits per format of SEL and its predecessors, oldest first */
+	if (sel == NULL) {
+		return;
+	}
+	dt_io_fmtsel_stats(whither, sel->next);
+	for (size_t i = 0U; i < sel->nfmt; i++) {
+		fprintf(whither, "%s\t%zu\n", sel->fmt[i], sel->f[i].hits);
+	}
+	fprintf(whither, "-\t%zu\n", sel->f[sel->nfmt].hits);
+	return;
+}
+
+void
+dt_io_fmtstats(FILE *whither)
+{
+/* print hits per input format for every format list in use */
+	dt_io_fmtsel_stats(whither, fmtsel);
+	if (nsig_try) {
+		/* parses avoided by the shape prefilter */
+		fprintf(whither, "avoided\t%zu/%zu\t%.1f%%\n",
+			nsig_rej, nsig_try, 100.f * nsig_rej / nsig_try);
+	}
+	return;
+}
+
+void
+dt_io_clear_fmtprogs(void)
+{
+	if (fmtprogs->data != NULL) {
+		for (acons_t c; (c = alist_next(fmtprogs)).val;) {
+			dt_strpdt_free(c.val);
+		}
+		free_alist(fmtprogs);
+	}
+	if (strfprogs->data != NULL) {
+		for (acons_t c; (c = alist_next(strfprogs)).val;) {
+			dt_strfdt_free(c.val);
+		}
+		free_alist(strfprogs);
+	}
+	dt_strfdt_free(strfprog_dflt);
+	strfprog_dflt = NULL;
+	for (struct dt_io_fmtsel_s *sel = fmtsel, *nxt; sel; sel = nxt) {
+		nxt = sel->next;
+		free(sel);
+	}
+	fmtsel = NULL;
+	return;
+}
+
 struct dt_dt_s
 dt_io_strpdt(
 	const char *str,
@@ -132,11 +524,7 @@ dt_io_strpdt(
 	} else if (nfmt == 0) {
 		res = dt_strpdt(str, NULL, NULL);
 	} else {
-		for (size_t i = 0; i < nfmt; i++) {
-			if (!dt_unk_p(res = dt_strpdt(str, fmt[i], NULL))) {
-				break;
-			}
-		}
+		res = dt_io_strpdt_fmts(str, fmt, nfmt, NULL);
 	}
 	return dtz_forgetz(res, zone);
 }
@@ -152,11 +540,7 @@ dt_io_strpdt_ep(
 	if (nfmt == 0) {
 		res = dt_strpdt(str, NULL, ep);
 	} else {
-		for (size_t i = 0; i < nfmt; i++) {
-			if (!dt_unk_p(res = dt_strpdt(str, fmt[i], ep))) {
-				break;
-			}
-		}
+		res = dt_io_strpdt_fmts(str, fmt, nfmt, ep);
 	}
 	return dtz_forgetz(res, zone);
 }
@@ -181,6 +565,26 @@ dt_io_find_strpdt(
 	return d;
 }
 
+/* needles for the char class specifiers, this isn't the bestest of
+ * approaches as it involves details about the contents behind the
+ * specifiers, they're compiled by build_needle() */
+enum {
+	CLS_A,
+	CLS_TA,
+	CLS_B,
+	CLS_TB,
+	CLS_O,
+	NCLS,
+};
+static const char *const cls_needle[NCLS] = {
+	[CLS_A] = "FMSTWfmstw",
+	[CLS_TA] = "MTWRFAS",
+	[CLS_B] = "ADFJMNOSadfjmnos",
+	[CLS_TB] = "FGHJKMNQUVXZ",
+	[CLS_O] = "CDILMVXcdilmvx",
+};
+static struct xmempbrk_s cls_ndlset[NCLS];
+
 struct dt_dt_s
 dt_io_find_strpdt2(
 	const char *str, size_t len,
@@ -193,7 +597,7 @@ dt_io_find_strpdt2(
 	const char *p = str;
 	const char *const zp = str + len;
 
-	for (; (p = xmempbrk(p, zp - p, needle)) < zp && *p; p++) {
+	for (; (p = xmempbrk_r(p, zp - p, &needles->ndlset)) < zp && *p; p++) {
 		/* find the offset */
 		const struct grpatm_payload_s *fp;
 		const char *np;
@@ -204,7 +608,7 @@ dt_io_find_strpdt2(
 		 * f is the associated grpatm payload */
 		while (*np++ == *p) {
 			const struct grpatm_payload_s f = *fp++;
-			const char *fmt = f.fmt;
+			dt_fmtprog_t fmt = f.prog;
 			const char *q = p + f.off_min;
 			const char *r = p + f.off_max;
 
@@ -213,7 +617,10 @@ dt_io_find_strpdt2(
 			}
 
 			for (; q < zp && q <= r; q++) {
-				if (!dt_unk_p(d = dt_strpdt(q, fmt, ep))) {
+				if (!dt_io_sigp(f.sig, q, zp)) {
+					continue;
+				} else if (!dt_unk_p(d = dt_strpdt_prog(fmt, q, ep))) {
+					dt_io_fmthit(needles->sel, f.idx);
 					p = q;
 					goto found;
 				}
@@ -223,42 +630,38 @@ dt_io_find_strpdt2(
 	/* otherwise check character classes */
 	for (size_t i = 0; needle[i] == GRPATM_NEEDLELESS_MODE_CHAR; i++) {
 		struct grpatm_payload_s f = needles->flesh[i];
-		const char *fmt = f.fmt;
-		const char *ndl;
+		dt_fmtprog_t fmt = f.prog;
+		const struct xmempbrk_s *ndl;
 
 		/* look out for char classes*/
 		switch (f.flags) {
-			/* this isn't the bestest of approaches as it involves
-			 * details about the contents behind the specifiers */
-			static const char a_needle[] = "FMSTWfmstw";
-			static const char ta_needle[] = "MTWRFAS";
-			static const char b_needle[] = "ADFJMNOSadfjmnos";
-			static const char tb_needle[] = "FGHJKMNQUVXZ";
-			static const char o_needle[] = "CDILMVXcdilmvx";
-
 		case GRPATM_A_SPEC:
-			ndl = a_needle;
+			ndl = cls_ndlset + CLS_A;
 			break;
 		case GRPATM_B_SPEC:
-			ndl = b_needle;
+			ndl = cls_ndlset + CLS_B;
 			break;
 		case GRPATM_TA_SPEC:
-			ndl = ta_needle;
+			ndl = cls_ndlset + CLS_TA;
 			break;
 		case GRPATM_TB_SPEC:
-			ndl = tb_needle;
+			ndl = cls_ndlset + CLS_TB;
 			break;
 		case GRPATM_O_SPEC:
-			ndl = o_needle;
+			ndl = cls_ndlset + CLS_O;
 			break;
 
 		case GRPATM_DIGITS:
 			/* yay, look for all digits */
 			for (p = str; p < zp && !(*p >= '0' && *p <= '9'); p++);
+			if (!dt_io_sigp(f.sig, p, zp)) {
+				continue;
+			}
 			for (const char *q = p;
 			     q < zp && *q >= '0' && *q <= '9'; q++) {
 				if ((--f.off_min <= 0) &&
-				    !dt_unk_p(d = dt_strpdt(p, fmt, ep))) {
+				    !dt_unk_p(d = dt_strpdt_prog(fmt, p, ep))) {
+					dt_io_fmthit(needles->sel, f.idx);
 					goto found;
 				}
 			}
@@ -267,6 +670,9 @@ dt_io_find_strpdt2(
 		case GRPATM_DIGITS | GRPATM_ORDINALS:
 			/* yay, look for all digits and ordinals */
 			for (p = str; p < zp && !(*p >= '0' && *p <= '9'); p++);
+			if (!dt_io_sigp(f.sig, p, zp)) {
+				continue;
+			}
 			for (const char *q = p; q < zp; q++) {
 				switch (*q) {
 				case '0' ... '9':
@@ -291,7 +697,8 @@ dt_io_find_strpdt2(
 					goto bugger;
 				}
 				if ((--f.off_min <= 0) &&
-				    !dt_unk_p(d = dt_strpdt(p, fmt, ep))) {
+				    !dt_unk_p(d = dt_strpdt_prog(fmt, p, ep))) {
+					dt_io_fmthit(needles->sel, f.idx);
 					goto found;
 				}
 			}
@@ -300,12 +707,17 @@ dt_io_find_strpdt2(
 			continue;
 		}
 		/* not reached unless ndl is set */
-		for (p = str; (p = xmempbrk(p, zp - p, ndl)) < zp && *p; p++) {
+		for (p = str;
+		     (p = xmempbrk_r(p, zp - p, ndl)) < zp && *p; p++) {
 			if (p + f.off_min < str || p + f.off_max > zp) {
 				continue;
 			}
 			for (int8_t j = f.off_min; j <= f.off_max; j++) {
-				if (!dt_unk_p(d = dt_strpdt(p + j, fmt, ep))) {
+				if (!dt_io_sigp(f.sig, p + j, zp)) {
+					continue;
+				} else if (!dt_unk_p(d = dt_strpdt_prog(
+							     fmt, p + j, ep))) {
+					dt_io_fmthit(needles->sel, f.idx);
 					p += j;
 					goto found;
 				}
@@ -314,15 +726,33 @@ dt_io_find_strpdt2(
 	}
 	/* reset to some sane defaults */
 	*ep = (char*)(p = str);
+	if (needles->sel != NULL) {
+		dt_io_fmthit(needles->sel, needles->sel->nfmt);
+	}
 found:
 	*sp = (char*)p;
 	return dtz_forgetz(d, zone);
 }
 
+void
+dt_io_prep(char *const *fmt, size_t nfmt, const char *ofmt)
+{
+/* compile FMT and OFMT and settle the base date, so that parsing
+ * and printing will only read shared state from now on */
+	if (nfmt) {
+		(void)dt_io_fmtsel(fmt, nfmt);
+	}
+	(void)dt_io_strfprog(ofmt);
+	(void)dt_get_base();
+	return;
+}
+
 int
-dt_io_write(struct dt_dt_s d, const char *fmt, zif_t zone, int apnd_ch)
+dt_io_fwrite(
+	struct dt_dt_s d, const char *fmt, zif_t zone, int apnd_ch,
+	FILE *whither)
 {
-	static char buf[256];
+	char buf[256];
 	size_t n;
 
 	if (zone != NULL) {
@@ -332,8 +762,8 @@ dt_io_write(struct dt_dt_s d, const char *fmt, zif_t zone, int apnd_ch)
 		d.zdiff = 0U;
 		d.neg = 0U;
 	}
-	n = dt_io_strfdt(buf, sizeof(buf), fmt, d, apnd_ch);
-	__io_write(buf, n, stdout);
+	n = dt_io_strfdt_prog(buf, sizeof(buf), dt_io_strfprog(fmt), d, apnd_ch);
+	__io_write(buf, n, whither);
 	return (n > 0) - 1;
 }
 
@@ -600,6 +1030,8 @@ build_needle(grep_atom_t atoms, size_t natoms, char *const *fmt, size_t nfmt)
 		res.flesh[idx].off_min = -4;
 		res.flesh[idx].off_max = -4;
 		res.flesh[idx].fmt = NULL;
+		res.flesh[idx].prog = NULL;
+		res.flesh[idx].sig = dt_io_shape_sig(NULL);
 
 		/* standard format, %T */
 		idx = res.natoms++;
@@ -607,11 +1039,17 @@ build_needle(grep_atom_t atoms, size_t natoms, char *const *fmt, size_t nfmt)
 		res.flesh[idx].off_min = -2;
 		res.flesh[idx].off_max = -1;
 		res.flesh[idx].fmt = NULL;
+		res.flesh[idx].prog = NULL;
+		res.flesh[idx].sig = dt_io_shape_sig(NULL);
 		goto out;
 	}
 	/* otherwise collect needles from all formats */
 	for (size_t i = 0; i < nfmt && res.natoms < natoms; i++) {
-		if ((a = calc_grep_atom(fmt[i])).needle) {
+		dt_fmtprog_t p;
+
+		if ((a = calc_grep_atom(fmt[i])).needle &&
+		    /* formats that won't compile have been moaned about */
+		    (p = dt_io_fmtprog(a.pl.fmt)) != NULL) {
 			const char *ndl = res.needle;
 			size_t idx = res.natoms++;
 			size_t j;
@@ -629,11 +1067,21 @@ build_needle(grep_atom_t atoms, size_t natoms, char *const *fmt, size_t nfmt)
 			}
 			res.needle[j] = a.needle;
 			res.flesh[j] = a.pl;
+			res.flesh[j].prog = p;
+			res.flesh[j].idx = i;
+			res.flesh[j].sig = dt_io_shape_sig(res.flesh[j].prog);
 		}
 	}
+	/* set up the dispatcher, if only for the hit counts */
+	res.sel = dt_io_fmtsel(fmt, nfmt);
 out:
 	/* terminate needle with \0 */
 	res.needle[res.natoms] = '\0';
+	xmempbrk_init(&res.ndlset, res.needle);
+	/* and the char class needles, once for all threads to share */
+	for (size_t i = 0U; i < countof(cls_ndlset); i++) {
+		xmempbrk_init(cls_ndlset + i, cls_needle[i]);
+	}
 	return res;
 }
 
@@ -660,6 +1108,62 @@ dt_io_unescape(char *s)
 	return;
 }
 
+int
+dt_io_fld(struct dt_io_fld_s *tgt, const char *fld, char *dlm)
+{
+/* set up field mode for field FLD (counting from 1) and delimiter DLM,
+ * DLM may contain escape sequences, a NULL FLD means whole lines */
+	unsigned long int k;
+	char *on;
+
+	if (fld == NULL) {
+		*tgt = (struct dt_io_fld_s){0U, '\t'};
+		return 0;
+	} else if ((k = strtoul(fld, &on, 10)) == 0U || *on || k > 0xffffU) {
+		error("Error: invalid field number `%s'", fld);
+		return -1;
+	}
+	/* we allow escapes in the delimiter, think '\t' */
+	dt_io_unescape(dlm);
+	if (dlm == NULL) {
+		/* tab it is, like cut(1) */
+		*tgt = (struct dt_io_fld_s){(unsigned int)k, '\t'};
+	} else if (dlm[0U] && !dlm[1U]) {
+		*tgt = (struct dt_io_fld_s){(unsigned int)k, dlm[0U]};
+	} else {
+		error("Error: delimiter must be a single character");
+		return -1;
+	}
+	return 0;
+}
+
+size_t
+dt_io_getfld(char **fp, char *line, size_t llen, struct dt_io_fld_s f)
+{
+/* find field F.FLD in LINE (of length LLEN), put its start into FP and
+ * return its length, missing fields are reported as empty fields at the
+ * very end of LINE */
+	char *const ep = line + llen;
+	char *p = line;
+	char *q;
+
+	if (UNLIKELY(!f.fld)) {
+		*fp = line;
+		return llen;
+	}
+	for (unsigned int i = 1U; i < f.fld; i++, p = q + 1U) {
+		if ((q = memchr(p, f.dlm, ep - p)) == NULL) {
+			*fp = ep;
+			return 0U;
+		}
+	}
+	if ((q = memchr(p, f.dlm, ep - p)) == NULL) {
+		q = ep;
+	}
+	*fp = p;
+	return q - p;
+}
+
 
 /* duration parser */
 /* we parse durations ourselves so we can cope with the
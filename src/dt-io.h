@@ -14,6 +14,7 @@
 #include <strings.h>
 #include "dt-core.h"
 #include "dt-io-zone.h"
+#include "strops.h"
 #include "nifty.h"
 
 typedef enum {
@@ -43,6 +44,12 @@ struct grpatm_payload_s {
 	int8_t off_min;
 	int8_t off_max;
 	const char *fmt;
+	/* FMT compiled */
+	dt_fmtprog_t prog;
+	/* FMT's index in the list of formats */
+	unsigned int idx;
+	/* byte classes FMT accepts in the first 8 positions */
+	uint64_t sig;
 };
 
 /* atoms are maps needle-character -> payload */
@@ -56,6 +63,11 @@ struct grep_atom_soa_s {
 	size_t natoms;
 	char *needle;
 	struct grpatm_payload_s *flesh;
+	/* NEEDLE compiled */
+	struct xmempbrk_s ndlset;
+	/* dispatcher of the format list the atoms came from,
+	 * hits are counted there */
+	struct dt_io_fmtsel_s *sel;
 };
 
 /* duration parser */
@@ -75,6 +87,20 @@ struct __strpdtdur_st_s {
 
 /* public API */
 extern dt_strpdt_special_t dt_io_strpdt_special(const char *str);
+
+/* compiled input and output formats, compile once, cache forever */
+extern dt_fmtprog_t dt_io_fmtprog(const char *fmt);
+extern dt_fmtprog_t dt_io_strfprog(const char *fmt);
+extern void dt_io_clear_fmtprogs(void);
+
+/* hits per input format (and misses), for the last used format list,
+ * counting starts with dt_io_fmtstats_on() */
+extern void dt_io_fmtstats_on(void);
+extern void dt_io_fmtstats(FILE *whither);
+
+/* compile everything needed ahead of processing in several threads */
+extern void dt_io_prep(char *const *fmt, size_t nfmt, const char *ofmt);
+
 extern struct dt_dt_s
 dt_io_strpdt(
 	const char *str,
@@ -101,7 +127,9 @@ dt_io_find_strpdt2(
 	zif_t zone);
 
 extern int
-dt_io_write(struct dt_dt_s d, const char *fmt, zif_t zone, int apnd_ch);
+dt_io_fwrite(
+	struct dt_dt_s d, const char *fmt, zif_t zone, int apnd_ch,
+	FILE *whither);
 
 /* grep atoms */
 extern struct grep_atom_s calc_grep_atom(const char *fmt);
@@ -111,6 +139,18 @@ build_needle(grep_atom_t atoms, size_t natoms, char *const *fmt, size_t nfmt);
 
 extern void dt_io_unescape(char *s);
 
+/* field mode, only look at field FLD (counting from 1) of a line,
+ * fields being separated by DLM, FLD == 0 means the whole line */
+struct dt_io_fld_s {
+	unsigned int fld;
+	char dlm;
+};
+
+extern int dt_io_fld(struct dt_io_fld_s *tgt, const char *fld, char *dlm);
+
+extern size_t
+dt_io_getfld(char **fp, char *line, size_t llen, struct dt_io_fld_s f);
+
 /* error messages, warnings, etc. */
 extern __attribute__((format(printf, 1, 2))) void error(const char *fmt, ...);
 
@@ -120,6 +160,9 @@ extern __attribute__((format(printf, 1, 2))) void serror(const char *fmt, ...);
 /* for error() above, use PROG as name for the tool. */
 extern const char *prog;
 
+/* error() and serror() write here if set, stderr otherwise. */
+extern __thread FILE *dt_io_errf;
+
 /* duration parser */
 extern int __add_dur(struct __strpdtdur_st_s *st, struct dt_dtdur_s dur);
 extern int dt_io_strpdtdur(struct __strpdtdur_st_s *st, const char *str);
@@ -156,6 +199,20 @@ dt_io_strfdt(
 	return res;
 }
 
+static inline size_t
+dt_io_strfdt_prog(
+	char *restrict buf, size_t bsz,
+	dt_fmtprog_t fprog, struct dt_dt_s that, int apnd_ch)
+{
+	size_t res = dt_strfdt_prog(buf, bsz, fprog, that);
+
+	if (LIKELY(res > 0) && apnd_ch && buf[res - 1] != apnd_ch) {
+		/* auto-newline */
+		buf[res++] = (char)apnd_ch;
+	}
+	return res;
+}
+
 
 static __attribute__((unused)) size_t
 __io_write(const char *line, size_t llen, FILE *where)
@@ -201,6 +258,12 @@ __io_eof_p(FILE *fp)
 #endif	/* __GLIBC__ */
 }
 
+static inline int
+dt_io_write(struct dt_dt_s d, const char *fmt, zif_t zone, int apnd_ch)
+{
+	return dt_io_fwrite(d, fmt, zone, apnd_ch, stdout);
+}
+
 static inline void
 dt_io_warn_strpdt(const char *inp)
 {
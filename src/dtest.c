@@ -158,6 +158,7 @@ Error: cannot find zone specified in --from-zone: `%s'", argi->from_zone_arg);
 	}
 clear:
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	if (argi->from_locale_arg) {
 		setilocale(NULL);
 	}
@@ -148,7 +148,6 @@ dz_write_nxtr(struct zrng_s r, zif_t z, const char *zn)
 {
 	char *restrict bp = gbuf;
 	const char *const ep = gbuf + sizeof(gbuf);
-	size_t ntr = zif_ntrans(z);
 
 	if (r.next >= STAMP_MAX) {
 		bp += xstrlcpy(bp, never, bp - ep);
@@ -157,16 +156,13 @@ dz_write_nxtr(struct zrng_s r, zif_t z, const char *zn)
 	}
 	/* append next indicator */
 	bp += xstrlcpy(bp, nindi, bp - ep);
-	if (r.trno + 1U < ntr) {
-		/* thank god there's another one */
-		stamp_t zdo = zif_troffs(z, r.trno + 1);
+	if (r.next < STAMP_MAX) {
+		/* thank god there's another one, possibly from the
+		 * zone's rule, so ask for the offset rather than trno */
+		stamp_t zdo = zif_find_zrng(z, r.next).offs;
 
-		if (r.next >= STAMP_MAX) {
-			goto never;
-		}
 		bp += dz_strftr(bp, ep - bp, (struct ztr_s){r.next, zdo});
 	} else {
-	never:
 		bp += xstrlcpy(bp, never, bp - ep);
 	}
 
@@ -188,7 +184,7 @@ dz_write_prtr(struct zrng_s r, zif_t z, const char *zn)
 
 	if (r.trno >= 1) {
 		/* there's one before that */
-		stamp_t zdo = zif_troffs(z, r.trno - 1);
+		stamp_t zdo = zif_find_zrng(z, r.prev - 1).offs;
 
 		bp += dz_strftr(bp, ep - bp, (struct ztr_s){r.prev, zdo});
 	} else {
@@ -350,6 +346,7 @@ nor a date/time corresponding to the given input formats", inp);
 clear:
 	/* release the zones */
 	dt_io_clear_zones();
+	dt_io_clear_fmtprogs();
 	/* release those arrays */
 	if (LIKELY(z != NULL)) {
 		free(z);
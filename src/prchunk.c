@@ -50,62 +50,79 @@
 #include <fcntl.h>
 #include <string.h>
 #include <stdint.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
 #include <stdarg.h>
 #include <errno.h>
+#if defined HAVE_PTHREAD_H
+# include <pthread.h>
+#endif	/* HAVE_PTHREAD_H */
+#if defined __SSE2__
+# include <emmintrin.h>
+#endif	/* __SSE2__ */
+#if defined __x86_64__ && defined __GNUC__
+# include <immintrin.h>
+# define HAVE_AVX2_DISPATCH
+#endif	/* __x86_64__ && __GNUC__ */
 
 #include "nifty.h"
 #include "prchunk.h"
 
-#define MAX_NLINES	(16384)
-#define MAX_LLEN	(1024)
-
-#if !defined MAP_ANONYMOUS && defined MAP_ANON
-# define MAP_ANONYMOUS	(MAP_ANON)
-#elif !defined MAP_ANON
-# define MAP_ANON	(0x1000U)
-#endif	/* MAP_ANON->MAP_ANONYMOUS */
+/* initial number of line offset slots, grows on demand */
+#define INI_NLINES	(16384U)
+/* read() sizes start small and double on every full read */
+#define MIN_RDZ		(4096U)
+#define MAX_RDZ		(1024U * 1024U)
 
 #if defined __INTEL_COMPILER
 # pragma warning(disable: 981)
 #endif	/* __INTEL_COMPILER */
 
-typedef uint32_t off32_t;
-typedef uint16_t off16_t;
-
 struct prch_ctx_s {
 	/* file descriptor */
 	int fd;
 	/* buffer */
 	char *buf;
+	/* number of bytes allocated for the buffer */
+	size_t bsz;
 	/* number of lines in the buffer */
 	uint32_t tot_lno;
-	/* number of columns per line */
-	uint32_t tot_cno;
 	/* number of bytes in the buffer */
 	size_t bno;
 	/* last known offset */
 	size_t off;
-	/* offsets */
-	off32_t loff[MAX_NLINES];
-	off32_t cur_lno;
-	/* delimiter offsets */
-	off16_t *soff;
+	/* number of bytes to read() next time */
+	size_t rdz;
+	/* offsets, shifted by one, the LSB denotes \r\n termination */
+	size_t *loff;
+	/* number of slots in loff */
+	uint32_t nloff;
+	uint32_t cur_lno;
+
+	/* read-only file mapping, BUF points into it then and lines
+	 * are handed out without \0-terminating them */
+	char *map;
+	size_t mapz;
+	/* offset of BUF within the mapping */
+	size_t mapo;
+	/* writable copies of mapped lines, see prchunk_getline_rw() */
+	char *lbuf;
+	size_t lbsz;
 };
 
-
+
 static inline void
-set_loff(prch_ctx_t ctx, uint32_t lno, off32_t off)
+set_loff(prch_ctx_t ctx, uint32_t lno, size_t off)
 {
 	ctx->loff[lno] = off;
 	ctx->loff[lno] <<= 1;
 	return;
 }
 
-static inline off32_t
+static inline size_t
 get_loff(prch_ctx_t ctx, uint32_t lno)
 {
-	off32_t res = ctx->loff[lno];
+	size_t res = ctx->loff[lno];
 	return res >> 1;
 }
 
@@ -134,162 +151,490 @@ get_llen(prch_ctx_t ctx, uint32_t lno)
 		get_loff(ctx, lno - 1) - 1;
 }
 
-
+
+/* byte indexers
+ * all of them store BASE + the offsets of C in S[0, N) into TGT, but no
+ * more than NTGT, the return value is the number of offsets stored and
+ * *NSCN is set to the number of bytes dealt with */
+typedef size_t(*memidx_f)(
+	size_t *restrict tgt, size_t ntgt,
+	const char *s, size_t n, char c, size_t base, size_t *nscn);
+
+static size_t
+memidx_gen(
+	size_t *restrict tgt, size_t ntgt,
+	const char *s, size_t n, char c, size_t base, size_t *nscn)
+{
+	const char *const eos = s + n;
+	size_t res = 0U;
+
+	for (const char *p = s;
+	     res < ntgt && (p = memchr(p, c, eos - p)) != NULL; p++) {
+		tgt[res++] = base + (p - s);
+	}
+	*nscn = res < ntgt ? n : res ? tgt[res - 1U] - base + 1U : 0U;
+	return res;
+}
+
+static inline size_t
+memidx_bits(
+	size_t *restrict tgt, size_t ntgt,
+	uint64_t m, size_t i, size_t base, size_t *nscn)
+{
+/* helper for the vector indexers, turn bit mask M into offsets */
+	size_t res = 0U;
+
+	for (; m && res < ntgt; m &= m - 1U) {
+		tgt[res++] = base + i + __builtin_ctzll(m);
+	}
+	if (UNLIKELY(m)) {
+		/* ran out of room */
+		*nscn = res ? tgt[res - 1U] - base + 1U : i;
+	}
+	return res;
+}
+
+#if defined __SSE2__
+static size_t
+memidx_sse2(
+	size_t *restrict tgt, size_t ntgt,
+	const char *s, size_t n, char c, size_t base, size_t *nscn)
+{
+	const __m128i vc = _mm_set1_epi8(c);
+	size_t res = 0U;
+	size_t i;
+
+	*nscn = 0U;
+	for (i = 0U; i + 16U <= n; i += 16U) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(s + i));
+		uint32_t m = _mm_movemask_epi8(_mm_cmpeq_epi8(x, vc));
+
+		res += memidx_bits(tgt + res, ntgt - res, m, i, base, nscn);
+		if (UNLIKELY(*nscn)) {
+			return res;
+		}
+	}
+	/* do the rest the old-fashioned way */
+	res += memidx_gen(tgt + res, ntgt - res, s + i, n - i, c, base + i, nscn);
+	*nscn += i;
+	return res;
+}
+#endif	/* __SSE2__ */
+
+#if defined HAVE_AVX2_DISPATCH
+static __attribute__((target("avx2"))) size_t
+memidx_avx2(
+	size_t *restrict tgt, size_t ntgt,
+	const char *s, size_t n, char c, size_t base, size_t *nscn)
+{
+	const __m256i vc = _mm256_set1_epi8(c);
+	size_t res = 0U;
+	size_t i;
+
+	*nscn = 0U;
+	for (i = 0U; i + 64U <= n; i += 64U) {
+		__m256i x0 = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i x1 = _mm256_loadu_si256((const __m256i*)(s + i + 32U));
+		__m256i m0 = _mm256_cmpeq_epi8(x0, vc);
+		__m256i m1 = _mm256_cmpeq_epi8(x1, vc);
+		uint64_t m;
+
+		if (_mm256_testz_si256(_mm256_or_si256(m0, m1),
+				       _mm256_or_si256(m0, m1))) {
+			/* long lines, nothing to see here */
+			continue;
+		}
+		m = (uint32_t)_mm256_movemask_epi8(m0);
+		m |= (uint64_t)(uint32_t)_mm256_movemask_epi8(m1) << 32U;
+		res += memidx_bits(tgt + res, ntgt - res, m, i, base, nscn);
+		if (UNLIKELY(*nscn)) {
+			return res;
+		}
+	}
+	/* do the rest the old-fashioned way */
+	res += memidx_gen(tgt + res, ntgt - res, s + i, n - i, c, base + i, nscn);
+	*nscn += i;
+	return res;
+}
+#endif	/* HAVE_AVX2_DISPATCH */
+
+static memidx_f memidx;
+
+static void
+memidx_init(void)
+{
+/* pick the best indexer for this machine */
+#if defined __SSE2__
+	memidx = memidx_sse2;
+#else  /* !__SSE2__ */
+	memidx = memidx_gen;
+#endif	/* __SSE2__ */
+#if defined HAVE_AVX2_DISPATCH
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		memidx = memidx_avx2;
+	}
+#endif	/* HAVE_AVX2_DISPATCH */
+	return;
+}
+
+static void
+memidx_once(void)
+{
+/* set up MEMIDX before any reader threads can come along */
+#if defined HAVE_PTHREAD_H
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+	pthread_once(&once, memidx_init);
+#else  /* !HAVE_PTHREAD_H */
+	if (memidx == NULL) {
+		memidx_init();
+	}
+#endif	/* HAVE_PTHREAD_H */
+	return;
+}
+
+
+static int
+grow_loff(prch_ctx_t ctx)
+{
+	const uint32_t nu = ctx->nloff ? 2U * ctx->nloff : INI_NLINES;
+	size_t *tmp;
+
+	if (UNLIKELY(nu < ctx->nloff)) {
+		/* 4 billion lines in one chunk, we better not */
+		return -1;
+	} else if ((tmp = realloc(ctx->loff, nu * sizeof(*tmp))) == NULL) {
+		return -1;
+	}
+	ctx->loff = tmp;
+	ctx->nloff = nu;
+	return 0;
+}
+
+static int
+grow_buf(prch_ctx_t ctx, size_t least)
+{
+	size_t nu = ctx->bsz ? ctx->bsz : 2U * MAX_RDZ;
+	char *tmp;
+
+	while (nu < least) {
+		nu *= 2U;
+	}
+	if ((tmp = realloc(ctx->buf, nu)) == NULL) {
+		return -1;
+	}
+	ctx->buf = tmp;
+	ctx->bsz = nu;
+	return 0;
+}
+
+static void
+index_lines(prch_ctx_t ctx, size_t from)
+{
+/* record offsets of all \n-terminated lines ending in [FROM, BNO),
+ * CTX->OFF is moved to the beginning of the first unterminated line */
+	while (from < ctx->bno) {
+		size_t *lp = ctx->loff + ctx->tot_lno;
+		size_t nscn;
+		size_t n;
+
+		if (UNLIKELY(ctx->tot_lno >= ctx->nloff)) {
+			if (UNLIKELY(grow_loff(ctx) < 0)) {
+				break;
+			}
+			continue;
+		}
+		/* find them all in one go */
+		n = memidx(
+			lp, ctx->nloff - ctx->tot_lno,
+			ctx->buf + from, ctx->bno - from, '\n', from, &nscn);
+		/* now massage our status structures */
+		for (size_t i = 0U; i < n; i++) {
+			char *p = ctx->buf + lp[i];
+
+			set_loff(ctx, ctx->tot_lno + i, lp[i]);
+			if (UNLIKELY(p > ctx->buf && p[-1] == '\r')) {
+				/* oh god, when is this nightmare gonna end */
+				set_lftermd(ctx, ctx->tot_lno + i);
+				if (ctx->map == NULL) {
+					p[-1] = '\0';
+				}
+			}
+			if (ctx->map == NULL) {
+				*p = '\0';
+			}
+		}
+		if (n) {
+			ctx->tot_lno += n;
+			ctx->off = get_loff(ctx, ctx->tot_lno - 1U) + 1U;
+		}
+		from += nscn;
+	}
+	return;
+}
+
+static int
+term_line(prch_ctx_t ctx, char *eob)
+{
+/* count the unterminated stretch up to EOB as line,
+ * the caller must make sure EOB is writable unless we're mapped */
+	if (UNLIKELY(ctx->tot_lno >= ctx->nloff) &&
+	    UNLIKELY(grow_loff(ctx) < 0)) {
+		return -1;
+	}
+	set_loff(ctx, ctx->tot_lno++, eob - ctx->buf);
+	if (ctx->map == NULL) {
+		*eob = '\0';
+	}
+	return 0;
+}
+
+static int
+prchunk_map(prch_ctx_t ctx)
+{
+/* try and map the file behind CTX->FD read-only, starting at its
+ * current offset, nothing is ever written to the mapping so its
+ * pages are shared with the page cache */
+	const size_t pgsz = sysconf(_SC_PAGESIZE);
+	struct stat st;
+	off_t beg;
+	size_t skip;
+	void *m;
+
+	if (fstat(ctx->fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		return -1;
+	} else if ((beg = lseek(ctx->fd, 0, SEEK_CUR)) < 0) {
+		return -1;
+	} else if (beg >= st.st_size) {
+		/* nothing to map, could also be a file in /proc */
+		return -1;
+	} else if ((uintmax_t)(st.st_size - beg) >= SIZE_MAX / 2U) {
+		/* won't fit into our address space */
+		return -1;
+	}
+	/* file offsets for mmap() must be page aligned */
+	skip = beg % pgsz;
+	beg -= skip;
+	ctx->mapz = st.st_size - beg;
+	m = mmap(NULL, ctx->mapz, PROT_READ, MAP_SHARED, ctx->fd, beg);
+	if (UNLIKELY(m == MAP_FAILED)) {
+		return -1;
+	}
+#if defined MADV_SEQUENTIAL
+	(void)madvise(m, ctx->mapz, MADV_SEQUENTIAL);
+#endif	/* MADV_SEQUENTIAL */
+	/* pretend we read() it all */
+	(void)lseek(ctx->fd, 0, SEEK_END);
+
+	ctx->map = m;
+	ctx->mapo = skip;
+	ctx->buf = ctx->map + ctx->mapo;
+	ctx->bno = 0U;
+	ctx->off = 0U;
+	return 0;
+}
+
+static void
+prchunk_ahead(prch_ctx_t ctx)
+{
+/* have the kernel page in the MAX_RDZ bytes past the window that is
+ * about to be indexed so they're there by the time we get to them */
+#if defined MADV_WILLNEED
+	const size_t pgsz = sysconf(_SC_PAGESIZE);
+	size_t beg = ctx->mapo + ctx->bno;
+	size_t end = beg + MAX_RDZ;
+
+	if (beg >= ctx->mapz) {
+		return;
+	} else if (end > ctx->mapz) {
+		end = ctx->mapz;
+	}
+	beg -= beg % pgsz;
+	(void)madvise(ctx->map + beg, end - beg, MADV_WILLNEED);
+#endif	/* MADV_WILLNEED */
+	return;
+}
+
+static int
+prchunk_fill_map(prch_ctx_t ctx)
+{
+/* like prchunk_fill() but instead of read()ing and copying the left over
+ * bytes we simply slide the buffer along the mapping */
+	ctx->tot_lno = 0U;
+	ctx->cur_lno = 0U;
+	/* advance past the lines that the caller has seen */
+	ctx->mapo += ctx->off;
+	ctx->buf = ctx->map + ctx->mapo;
+	ctx->bno = 0U;
+	ctx->off = 0U;
+	if (UNLIKELY(ctx->mapo >= ctx->mapz)) {
+		/* all consumed */
+		return -1;
+	}
+
+	do {
+		const size_t left = ctx->mapz - ctx->mapo;
+		const size_t from = ctx->bno;
+
+		if (UNLIKELY(from >= left)) {
+			/* last line then, unyielded :| */
+			if (UNLIKELY(term_line(ctx, ctx->buf + ctx->bno) < 0)) {
+				return -1;
+			}
+			ctx->off = ctx->bno;
+			break;
+		}
+		/* index the next MAX_RDZ bytes */
+		ctx->bno = left - from > MAX_RDZ ? from + MAX_RDZ : left;
+		prchunk_ahead(ctx);
+		index_lines(ctx, from);
+	} while (!ctx->tot_lno);
+	return 0;
+}
+
+
 /* internal operations */
 FDEFU int
 prchunk_fill(prch_ctx_t ctx)
 {
-/* this is a coroutine consisting of a line counter yielding the number of
- * lines read so far and a reader yielding a buffer fill and the number of
- * bytes read */
-#define CHUNK_SIZE	(4096)
-#define YIELD(x)	goto yield##x
-	char *off = ctx->buf + 0;
-	char *bno = ctx->buf + ctx->bno;
-	ssize_t nrd;
-
+/* read until there's at least one complete line in the buffer, the size
+ * of the read()s doubles whenever the previous one came back full */
+	if (ctx->map != NULL) {
+		return prchunk_fill_map(ctx);
+	}
 	/* initial work, reset the line counters et al */
-	ctx->tot_lno = 0;
-	/* we just memcpy() the left over stuff to the front and restart
-	 * from there, someone left us a note in __ctx with the left
-	 * over offset */
-	/* normally we'd use memmove() but we know there's little chance
-	 * for overlapping regions */
+	ctx->tot_lno = 0U;
+	ctx->cur_lno = 0U;
+	/* move the left over stuff (which contains no \n) to the front
+	 * and restart from there */
 	if (UNLIKELY(ctx->bno == 0)) {
 		/* do nothing */
 		;
 	} else if (LIKELY(ctx->bno > ctx->off)) {
-		size_t rsz = ctx->bno - ctx->off;
-		/* move the top RSZ bytes to the beginning */
-		memcpy(ctx->buf, ctx->buf + ctx->off, rsz);
-		ctx->bno = rsz;
-		bno = ctx->buf + rsz;
+		ctx->bno -= ctx->off;
+		memmove(ctx->buf, ctx->buf + ctx->off, ctx->bno);
 	} else if (UNLIKELY(ctx->bno == ctx->off)) {
 		/* what are the odds? just reset the counters */
 		ctx->bno = 0;
-		bno = ctx->buf;
 	} else {
 		/* the user didn't see the end of the file */
 		return -1;
 	}
+	ctx->off = 0U;
 
-yield1:
-	/* read CHUNK_SIZE bytes */
-	bno += (nrd = read(ctx->fd, bno, CHUNK_SIZE));
-	/* if we came from yield2 then off == __ctx->bno, and if we
-	 * read 0 or less bytes then off >= __ctx->bno + nrd, so we
-	 * can simply use that compact expression if the buffer has no
-	 * more input.
-	 * On the contrary if we came from the outside, i.e. fill_buffer()
-	 * has been called, then off would be 0 and __ctx->bno would be
-	 * the buffer filled so far, if no more bytes could be read then
-	 * we'd proceed processing them (off < __ctx->bno + nrd */
-	if (UNLIKELY(!nrd && off < bno && ctx->cur_lno <= ctx->tot_lno)) {
-		/* last line then, unyielded :| */
-		set_loff(ctx, ctx->tot_lno, bno - ctx->buf);
-		off = bno;
-		/* count it as line and check if we need more */
-		if (++ctx->tot_lno >= MAX_NLINES) {
-			YIELD(3);
-		}
-		YIELD(4);
-	} else if (UNLIKELY(nrd <= 0 && off == ctx->buf)) {
-		/* special case, we worked our arses off and nothing's
-		 * in the pipe line so just fuck off here */
-		if (!ctx->bno) {
+	do {
+		ssize_t nrd;
+
+		/* keep room for the final \0 of an unterminated line */
+		if (ctx->bno + ctx->rdz >= ctx->bsz &&
+		    UNLIKELY(grow_buf(ctx, ctx->bno + ctx->rdz + 1U) < 0)) {
 			return -1;
 		}
-		/* go to drain mode */
-		YIELD(2);
-	} else if (LIKELY(off < bno || off == ctx->buf)) {
-		YIELD(2);
-	}
-	/* proceed to exit */
-	YIELD(3);
-yield2:
-	while (off < bno) {
-		size_t rsz = bno - off;
-		char *p = memchr(off, '\n', rsz);
-		if (UNLIKELY(p == NULL)) {
-			if (LIKELY(nrd > 0)) {
-				break;
+		if ((nrd = read(ctx->fd, ctx->buf + ctx->bno, ctx->rdz)) <= 0) {
+			/* drain mode */
+			if (ctx->bno == 0U) {
+				/* we worked our arses off and nothing's
+				 * in the pipe line so just fuck off here */
+				return -1;
+			} else if (UNLIKELY(term_line(
+					    ctx, ctx->buf + ctx->bno) < 0)) {
+				return -1;
 			}
-			/* not concluded with \n, let's hope we're in drain mode */
-			return -1;
-		}
-		/* massage our status structures */
-		set_loff(ctx, ctx->tot_lno, p - ctx->buf);
-		if (UNLIKELY(p[-1] == '\r')) {
-			/* oh god, when is this nightmare gonna end */
-			p[-1] = '\0';
-			set_lftermd(ctx, ctx->tot_lno);
-		}
-		*p = '\0';
-		off = ++p;
-		/* count it as line and check if we need more */
-		if (++ctx->tot_lno >= MAX_NLINES) {
-			YIELD(3);
+			/* last line then, unyielded :| */
+			ctx->off = ctx->bno;
+			break;
+		} else if ((size_t)nrd == ctx->rdz && ctx->rdz < MAX_RDZ) {
+			/* pipe seems to be keeping up */
+			ctx->rdz *= 2U;
 		}
-	}
-	YIELD(1);
-yield3:
-	/* need clean up, something like unread(),
-	 * in particular leave a note in __ctx with the left over offset */
-	ctx->cur_lno = 0;
-yield4:
-	ctx->off = off - ctx->buf;
-	ctx->bno = bno - ctx->buf;
-#undef YIELD
-#undef CHUNK_SIZE
+		ctx->bno += nrd;
+		/* only the freshly read bytes can contain new \ns */
+		index_lines(ctx, ctx->bno - nrd);
+	} while (!ctx->tot_lno);
 	return 0;
 }
 
-
+
 /* public operations */
 FDEFU prch_ctx_t
 init_prchunk(int fd)
 {
-#define MAP_MEM		(MAP_ANON | MAP_PRIVATE)
-#define PROT_MEM	(PROT_READ | PROT_WRITE)
-#define MAP_LEN		(MAX_NLINES * MAX_LLEN)
-	static struct prch_ctx_s __ctx;
+	prch_ctx_t ctx;
+	struct stat st;
 
-	__ctx.buf = mmap(NULL, MAP_LEN, PROT_MEM, MAP_MEM, -1, 0);
-	if (__ctx.buf == MAP_FAILED) {
+	memidx_once();
+	/* start afresh */
+	if (UNLIKELY((ctx = calloc(1U, sizeof(*ctx))) == NULL)) {
 		return NULL;
 	}
+	ctx->fd = fd;
+	ctx->rdz = MIN_RDZ;
 
-	/* bit of space for the rechunker */
-	__ctx.soff = mmap(NULL, MAP_LEN, PROT_MEM, MAP_MEM, -1, 0);
-	if (__ctx.soff == MAP_FAILED) {
+	if (UNLIKELY(grow_loff(ctx) < 0)) {
+		free_prchunk(ctx);
+		return NULL;
+	} else if (UNLIKELY(grow_buf(ctx, 0U) < 0)) {
+		free_prchunk(ctx);
 		return NULL;
 	}
 
-	if ((__ctx.fd = fd) > STDIN_FILENO) {
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		/* files deliver full buffers, no need to probe */
+		ctx->rdz = MAX_RDZ;
 #if defined POSIX_FADV_SEQUENTIAL
 		/* give advice about our read pattern */
 		int rc = posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
 		if (UNLIKELY(rc < 0)) {
-			munmap(__ctx.soff, MAP_LEN);
+			free_prchunk(ctx);
 			return NULL;
 		}
 #endif	/* POSIX_FADV_SEQUENTIAL */
 	}
-	return &__ctx;
+	return ctx;
+}
+
+FDEFU prch_ctx_t
+init_prchunk_ro(int fd)
+{
+	prch_ctx_t ctx;
+
+	memidx_once();
+	if (UNLIKELY((ctx = calloc(1U, sizeof(*ctx))) == NULL)) {
+		return NULL;
+	}
+	ctx->fd = fd;
+	if (prchunk_map(ctx) < 0) {
+		/* no regular file, so read() it is */
+		free(ctx);
+		return init_prchunk(fd);
+	} else if (UNLIKELY(grow_loff(ctx) < 0)) {
+		free_prchunk(ctx);
+		return NULL;
+	}
+	return ctx;
 }
 
 FDEFU void
 free_prchunk(prch_ctx_t ctx)
 {
-	if (LIKELY(ctx->buf != NULL)) {
-		munmap(ctx->buf, MAP_LEN);
-		ctx->buf = NULL;
+	if (ctx->map != NULL) {
+		munmap(ctx->map, ctx->mapz);
+	} else if (LIKELY(ctx->buf != NULL)) {
+		free(ctx->buf);
+	}
+	if (ctx->lbuf != NULL) {
+		free(ctx->lbuf);
 	}
+	if (LIKELY(ctx->loff != NULL)) {
+		free(ctx->loff);
+	}
+	free(ctx);
 	return;
 }
 
-
+
 /* accessors/iterators/et al. */
 FDEFU size_t
 prchunk_get_nlines(prch_ctx_t ctx)
@@ -318,109 +663,54 @@ prchunk_getline(prch_ctx_t ctx, char **p)
 	return prchunk_getlineno(ctx, p, ctx->cur_lno++);
 }
 
-FDEFU void
-prchunk_reset(prch_ctx_t ctx)
-{
-	ctx->cur_lno = 0;
-	return;
-}
-
-FDEFU int
-prchunk_haslinep(prch_ctx_t ctx)
-{
-/* the second condition is to allow unterminated last lines */
-	return ctx->cur_lno < ctx->tot_lno || ctx->cur_lno == 0U;
-}
-
-
-static inline void
-set_ncols(prch_ctx_t ctx, size_t ncols)
-{
-	ctx->tot_cno = ncols;
-	return;
-}
-
 FDEFU size_t
-prchunk_get_ncols(prch_ctx_t ctx)
+prchunk_getline_rw(prch_ctx_t ctx, char **p)
 {
-	return ctx->tot_cno;
-}
-
-static inline void
-set_col_off(prch_ctx_t ctx, size_t lno, size_t cno, size_t off)
-{
-	ctx->soff[lno * prchunk_get_ncols(ctx) + cno] = (off16_t)off;
-	return;
+/* like prchunk_getline() but *P is always \0-terminated and writable,
+ * mapped lines are copied to a buffer of CTX for that which stays
+ * valid until the next call, *P is NULL if that buffer can't grow */
+	size_t llen = prchunk_getline(ctx, p);
+
+	if (ctx->map == NULL || *p == NULL) {
+		return llen;
+	} else if (UNLIKELY(llen >= ctx->lbsz)) {
+		size_t nu = ctx->lbsz ? ctx->lbsz : MIN_RDZ;
+		char *tmp;
+
+		while (nu <= llen) {
+			nu *= 2U;
+		}
+		if (UNLIKELY((tmp = realloc(ctx->lbuf, nu)) == NULL)) {
+			*p = NULL;
+			return 0U;
+		}
+		ctx->lbuf = tmp;
+		ctx->lbsz = nu;
+	}
+	memcpy(ctx->lbuf, *p, llen);
+	ctx->lbuf[llen] = '\0';
+	*p = ctx->lbuf;
+	return llen;
 }
 
-static inline off16_t
-get_col_off(prch_ctx_t ctx, size_t lno, size_t cno)
+FDEFU int
+prchunk_mapped_p(prch_ctx_t ctx)
 {
-	return ctx->soff[lno * prchunk_get_ncols(ctx) + cno];
+	return ctx->map != NULL;
 }
 
-/* rechunker, chop the lines into smaller bits
- * Strategy is to go over all lines in the current chunk and
- * memchr() for the delimiter DELIM.
- * Store the offsets into __ctx->soff and bugger off leaving a \0
- * where the delimiter was. */
 FDEFU void
-prchunk_rechunk(prch_ctx_t ctx, char dlm, int ncols)
+prchunk_reset(prch_ctx_t ctx)
 {
-/* very naive implementation, we prefer prchunk_rechunk_by_dstfld()
- * where a distance histogram demarks possible places */
-	size_t lno = 0;
-	size_t cno = 0;
-	char *line;
-	char *off;
-	char *p;
-	char *bno = ctx->buf + ctx->off;
-	size_t rsz;
-
-	set_ncols(ctx, ncols);
-	off = line = ctx->buf;
-	rsz = bno - off;
-	while ((p = memchr(off, dlm, rsz)) != NULL) {
-		size_t co;
-		size_t llen = get_llen(ctx, lno);
-		while ((co = p - line) > llen) {
-			/* last column offset equals the length of the line */
-			set_col_off(ctx, lno, cno, llen);
-			/* get the new line */
-			line = ctx->buf + get_loff(ctx, lno++) + 1;
-			cno = 0;
-		}
-		/* store the offset of the column within the line */
-		set_col_off(ctx, lno, cno++, co);
-		/* prepare the counters for the next round */
-		*p = '\0';
-		off = ++p;
-		rsz = bno - off;
-	}
-	/* last column offset equals the length of the line */
-	rsz = get_llen(ctx, lno);
-	set_col_off(ctx, lno, cno, rsz);
+	ctx->cur_lno = 0;
 	return;
 }
 
-FDEFU size_t
-prchunk_getcolno(prch_ctx_t ctx, char **p, int lno, int cno)
+FDEFU int
+prchunk_haslinep(prch_ctx_t ctx)
 {
-	size_t co1, co2;
-
-	if (UNLIKELY(cno < 0 || (size_t)cno >= prchunk_get_ncols(ctx))) {
-		*p = NULL;
-		return 0;
-	}
-	(void)prchunk_getlineno(ctx, p, lno);
-	if (UNLIKELY(cno == 0)) {
-		return get_col_off(ctx, lno, 0);
-	}
-	/* likely case last */
-	co1 = get_col_off(ctx, lno, cno);
-	co2 = get_col_off(ctx, lno, cno - 1);
-	*p += co2 + 1;
-	return co1 - co2 - 1;
+/* the second condition is to allow unterminated last lines */
+	return ctx->cur_lno < ctx->tot_lno || ctx->cur_lno == 0U;
 }
 
 
@@ -48,21 +48,26 @@
 
 typedef struct prch_ctx_s *prch_ctx_t;
 
-/* non-reentrant! */
+/* one context per FD, contexts are independent of each other */
 FDECL prch_ctx_t init_prchunk(int fd);
+/* like init_prchunk() but regular files are mapped read-only,
+ * lines are not \0-terminated then, use the lengths handed out */
+FDECL prch_ctx_t init_prchunk_ro(int fd);
 FDECL void free_prchunk(prch_ctx_t);
 
 FDECL int prchunk_fill(prch_ctx_t ctx);
 
 FDECL size_t prchunk_get_nlines(prch_ctx_t);
-FDECL size_t prchunk_get_ncols(prch_ctx_t);
 
 FDECL size_t prchunk_getlineno(prch_ctx_t ctx, char **p, int lno);
 FDECL size_t prchunk_getline(prch_ctx_t ctx, char **p);
+/* like prchunk_getline() but the line is \0-terminated and writable,
+ * lines of mapped files are copied for that */
+FDECL size_t prchunk_getline_rw(prch_ctx_t ctx, char **p);
+/* non-0 if lines point into the mapping of the whole file, they stay
+ * valid until free_prchunk() then */
+FDECL int prchunk_mapped_p(prch_ctx_t ctx);
 FDECL void prchunk_reset(prch_ctx_t ctx);
 FDECL int prchunk_haslinep(prch_ctx_t ctx);
 
-FDECL void prchunk_rechunk(prch_ctx_t ctx, char delim, int ncols);
-FDECL size_t prchunk_getcolno(prch_ctx_t ctx, char **p, int lno, int cno);
-
 #endif	/* INCLUDED_prchunk_h_ */
@@ -0,0 +1,78 @@
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dt-core.h"
+#include "nifty.h"
+
+/* the ISO 8601 fast path mustn't depend on where the string lives,
+ * so parse every string once straddling a page boundary and once at
+ * the start of a page, results and rates should be the same */
+#define PGSZ	(4096U)
+
+static const char *tsts[] = {
+	"2012-03-28",
+	"12:34:56",
+	"12:34:56.789",
+	"2012-03-28T12:34:56",
+	"2012-03-28 12:34:56",
+	"2012-03-28T12:34:56.789",
+	"2012-03-28T12:34:56+01:00",
+	"2012-03-28T24:00:00",
+};
+
+static double
+now(void)
+{
+	struct timespec tsp;
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return (double)tsp.tv_sec + (double)tsp.tv_nsec / 1000000000;
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000U;
+	char *pg;
+	int rc = 0;
+
+	if ((pg = aligned_alloc(PGSZ, 2U * PGSZ)) == NULL) {
+		return 1;
+	}
+	for (size_t i = 0U; i < countof(tsts); i++) {
+		const size_t z = strlen(tsts[i]) + 1U;
+		/* 3 bytes before the page end, and page start */
+		char *pe = pg + PGSZ - 3U;
+		char *ps = pg;
+		struct dt_dt_s d1 = {DT_UNK}, d2 = {DT_UNK};
+		unsigned int s1 = 0U, s2 = 0U;
+		double t1, t2;
+
+		memcpy(ps, tsts[i], z);
+		memcpy(pe, tsts[i], z);
+
+		t1 = now();
+		for (size_t j = 0U; j < n; j++) {
+			d1 = dt_strpdt(pe, NULL, NULL);
+			s1 += d1.d.u ^ d1.t.u;
+		}
+		t1 = now() - t1;
+
+		t2 = now();
+		for (size_t j = 0U; j < n; j++) {
+			d2 = dt_strpdt(ps, NULL, NULL);
+			s2 += d2.d.u ^ d2.t.u;
+		}
+		t2 = now() - t2;
+
+		printf("%-28s\tstraddling %.0f/s\taligned %.0f/s\t%.2fx\n",
+		       tsts[i], (double)n / t1, (double)n / t2, t1 / t2);
+		/* both placements must agree */
+		rc |= s1 != s2 || d1.d.u != d2.d.u || d1.t.u != d2.t.u;
+	}
+	free(pg);
+	return rc;
+}
@@ -0,0 +1,140 @@
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include "prchunk.h"
+#include "prchunk.c"
+#include "nifty.h"
+
+static double
+now(void)
+{
+	struct timespec tsp;
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return (double)tsp.tv_sec + (double)tsp.tv_nsec / 1000000000;
+}
+
+static void
+mkcorpus(int fd, size_t nlines, size_t avg)
+{
+	static char buf[65536U];
+	size_t bi = 0U;
+
+	for (size_t i = 0U; i < nlines; i++) {
+		size_t len = avg / 2U + (size_t)rand() % avg;
+
+		for (size_t j = 0U; j < len; j++) {
+			buf[bi++] = (char)('a' + j % 26U);
+			if (bi >= sizeof(buf)) {
+				write(fd, buf, bi);
+				bi = 0U;
+			}
+		}
+		buf[bi++] = '\n';
+		if (bi >= sizeof(buf)) {
+			write(fd, buf, bi);
+			bi = 0U;
+		}
+	}
+	write(fd, buf, bi);
+	return;
+}
+
+static size_t
+count(int fd, int rop)
+{
+	prch_ctx_t ctx;
+	size_t n = 0U;
+
+	if ((ctx = !rop ? init_prchunk(fd) : init_prchunk_ro(fd)) == NULL) {
+		return 0U;
+	}
+	while (prchunk_fill(ctx) >= 0) {
+		for (char *line; prchunk_haslinep(ctx); n++) {
+			(void)prchunk_getline(ctx, &line);
+		}
+	}
+	free_prchunk(ctx);
+	return n;
+}
+
+static void
+bench(const char *fn, const char *what)
+{
+	double t;
+	size_t n;
+	int fd;
+
+	/* regular file, read at full size right away */
+	fd = open(fn, O_RDONLY);
+	t = now();
+	n = count(fd, 0);
+	t = now() - t;
+	close(fd);
+	printf("%s\tfile\t%zu lines\t%.0f lines/s\n", what, n, (double)n / t);
+
+	/* regular file, mapped read-only */
+	fd = open(fn, O_RDONLY);
+	t = now();
+	n = count(fd, 1);
+	t = now() - t;
+	close(fd);
+	printf("%s\tmap\t%zu lines\t%.0f lines/s\n", what, n, (double)n / t);
+
+	/* through a pipe, read sizes adapt */
+	with (int pfd[2]) {
+		pid_t p;
+
+		if (pipe(pfd) < 0) {
+			break;
+		} else if ((p = fork()) == 0) {
+			char buf[65536U];
+			ssize_t nrd;
+
+			close(pfd[0U]);
+			fd = open(fn, O_RDONLY);
+			while ((nrd = read(fd, buf, sizeof(buf))) > 0) {
+				write(pfd[1U], buf, nrd);
+			}
+			_exit(0);
+		}
+		close(pfd[1U]);
+		t = now();
+		n = count(pfd[0U], 0);
+		t = now() - t;
+		close(pfd[0U]);
+		waitpid(p, NULL, 0);
+		printf("%s\tpipe\t%zu lines\t%.0f lines/s\n", what, n, (double)n / t);
+	}
+	return;
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t nlines = argc > 1 ? strtoul(argv[1], NULL, 0) : 4000000U;
+	char fn[] = "/tmp/prchunk-bench.XXXXXX";
+	int fd;
+
+	if ((fd = mkstemp(fn)) < 0) {
+		return 1;
+	}
+	/* short lines, log-like */
+	mkcorpus(fd, nlines, 40U);
+	bench(fn, "short");
+
+	/* long lines, JSON-like */
+	ftruncate(fd, 0);
+	lseek(fd, 0, SEEK_SET);
+	mkcorpus(fd, nlines / 64U, 4096U);
+	bench(fn, "long");
+
+	close(fd);
+	unlink(fn);
+	return 0;
+}
@@ -0,0 +1,62 @@
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dt-core.h"
+#include "nifty.h"
+
+static const struct {
+	const char *fmt;
+	const char *str;
+} tsts[] = {
+	{"%F", "2012-03-28"},
+	{"%FT%T", "2012-03-28T12:34:56"},
+	{"%d/%m/%Y %H:%M:%S", "28/03/2012 12:34:56"},
+	{"%a, %d %b %Y %H:%M:%S", "Wed, 28 Mar 2012 12:34:56"},
+	{"%Y%m%d", "20120328"},
+	{"ymd", "2012-03-28T12:34:56"},
+};
+
+static double
+now(void)
+{
+	struct timespec tsp;
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return (double)tsp.tv_sec + (double)tsp.tv_nsec / 1000000000;
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000U;
+	int rc = 0;
+
+	for (size_t i = 0U; i < countof(tsts); i++) {
+		const char *fmt = tsts[i].fmt;
+		const char *str = tsts[i].str;
+		dt_fmtprog_t prog = dt_strpdt_compile(fmt);
+		unsigned int s1 = 0U, s2 = 0U;
+		double t1, t2;
+
+		t1 = now();
+		for (size_t j = 0U; j < n; j++) {
+			s1 += dt_strpdt(str, fmt, NULL).d.u;
+		}
+		t1 = now() - t1;
+
+		t2 = now();
+		for (size_t j = 0U; j < n; j++) {
+			s2 += dt_strpdt_prog(prog, str, NULL).d.u;
+		}
+		t2 = now() - t2;
+
+		printf("%-24s\tstrpdt %.0f/s\tprog %.0f/s\t%.2fx\n",
+		       fmt, (double)n / t1, (double)n / t2, t1 / t2);
+		/* both paths must agree */
+		rc |= s1 != s2;
+		dt_strpdt_free(prog);
+	}
+	return rc;
+}
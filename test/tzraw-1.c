@@ -0,0 +1,137 @@
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#if defined HAVE_PTHREAD_H
+# include <pthread.h>
+#endif	/* HAVE_PTHREAD_H */
+#include "tzraw.h"
+#include "nifty.h"
+
+/* 1970 to 2040 in steps of a little less than a day */
+#define FROM	(0)
+#define TILL	(2208988800)
+#define STEP	(86399)
+
+static zif_t z;
+
+static int
+chk(void)
+{
+/* two cursors on the same zone must not get in each other's way and
+ * must agree with the cursor-less API */
+	zif_cursor_t c1 = zif_cursor(z);
+	zif_cursor_t c2 = zif_cursor(z);
+	int res = 0;
+
+	for (stamp_t t = FROM, u = TILL; t < TILL; t += STEP, u -= STEP) {
+		stamp_t l1 = zif_local_time_c(&c1, t);
+		stamp_t l2 = zif_local_time_c(&c2, u);
+
+		if (l1 != zif_local_time(z, t)) {
+			fprintf(stderr, "local %lld differs\n", (long long)t);
+			res = 1;
+		} else if (l2 != zif_local_time(z, u)) {
+			fprintf(stderr, "local %lld differs\n", (long long)u);
+			res = 1;
+		} else if (zif_utc_time_c(&c2, l1) != zif_utc_time(z, l1)) {
+			fprintf(stderr, "utc %lld differs\n", (long long)l1);
+			res = 1;
+		}
+	}
+	return res;
+}
+
+static int
+chk_v(void)
+{
+/* the batch versions must agree with the scalar ones, sorted or not */
+	const size_t n = (size_t)((TILL - FROM) / STEP);
+	stamp_t *in, *out;
+	int res = 0;
+
+	if ((in = malloc(2U * n * sizeof(*in))) == NULL) {
+		return 1;
+	}
+	out = in + n;
+	for (size_t k = 0U; k < 2U; k++) {
+		for (size_t i = 0U; i < n; i++) {
+			/* sorted the first time round, scrambled the second */
+			const size_t j = k ? (i * 7919U) % n : i;
+			in[i] = FROM + (stamp_t)j * STEP;
+		}
+		zif_local_time_v(z, in, out, n);
+		for (size_t i = 0U; i < n; i++) {
+			if (out[i] != zif_local_time(z, in[i])) {
+				fprintf(stderr, "local_v %lld differs\n",
+					(long long)in[i]);
+				res = 1;
+			}
+		}
+		zif_utc_time_v(z, in, out, n);
+		for (size_t i = 0U; i < n; i++) {
+			if (out[i] != zif_utc_time(z, in[i])) {
+				fprintf(stderr, "utc_v %lld differs\n",
+					(long long)in[i]);
+				res = 1;
+			}
+		}
+	}
+	/* in place */
+	memcpy(out, in, n * sizeof(*in));
+	zif_local_time_v(z, out, out, n);
+	for (size_t i = 0U; i < n; i++) {
+		if (out[i] != zif_local_time(z, in[i])) {
+			fprintf(stderr, "local_v in place %lld differs\n",
+				(long long)in[i]);
+			res = 1;
+		}
+	}
+	free(in);
+	return res;
+}
+
+#if defined HAVE_PTHREAD_H
+static void*
+work(void *UNUSED(clo))
+{
+	return (void*)(intptr_t)chk();
+}
+#endif	/* HAVE_PTHREAD_H */
+
+int
+main(void)
+{
+	int rc = 0;
+
+	if ((z = zif_open("Europe/Berlin")) == NULL) {
+		/* no zoneinfo files, skip */
+		return 77;
+	}
+
+	rc |= chk();
+	rc |= chk_v();
+#if defined HAVE_PTHREAD_H
+	/* now share Z between threads */
+	{
+		pthread_t thr[4U];
+		void *r;
+
+		for (size_t i = 0U; i < countof(thr); i++) {
+			pthread_create(thr + i, NULL, work, NULL);
+		}
+		for (size_t i = 0U; i < countof(thr); i++) {
+			pthread_join(thr[i], &r);
+			rc |= (int)(intptr_t)r;
+		}
+	}
+#endif	/* HAVE_PTHREAD_H */
+
+	zif_close(z);
+	return rc;
+}
+
+/* tzraw-1.c ends here */
@@ -0,0 +1,126 @@
+#if defined HAVE_CONFIG_H
+# include "config.h"
+#endif	/* HAVE_CONFIG_H */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "tzraw.h"
+#include "nifty.h"
+
+/* 1900-01-01 to 2100-01-01 */
+#define FROM	(-2208988800LL)
+#define TILL	(4102444800LL)
+
+static const char *zns[] = {
+	"Europe/Berlin",
+	"America/New_York",
+	"Australia/Sydney",
+	"Asia/Kolkata",
+};
+
+static volatile stamp_t sink;
+
+static double
+now(void)
+{
+	struct timespec tsp;
+	clock_gettime(CLOCK_MONOTONIC, &tsp);
+	return (double)tsp.tv_sec + (double)tsp.tv_nsec / 1000000000;
+}
+
+static uint64_t
+xrand(uint64_t x[static 1U])
+{
+	/* xorshift64, we just need it reproducible */
+	*x ^= *x << 13U;
+	*x ^= *x >> 7U;
+	*x ^= *x << 17U;
+	return *x;
+}
+
+static int
+stamp_cmp(const void *a, const void *b)
+{
+	const stamp_t x = *(const stamp_t*)a;
+	const stamp_t y = *(const stamp_t*)b;
+	return (x > y) - (x < y);
+}
+
+static void
+bench(const char *zn, const char *what, const stamp_t *ts, stamp_t *tv, size_t n)
+{
+	zif_t z;
+	zif_cursor_t c;
+	stamp_t s1 = 0, s2 = 0;
+	double t1, t2, t3, t4;
+
+	if ((z = zif_open(zn)) == NULL) {
+		return;
+	}
+
+	c = zif_cursor(z);
+	t1 = now();
+	for (size_t j = 0U; j < n; j++) {
+		s1 += zif_local_time_c(&c, ts[j]);
+	}
+	t1 = now() - t1;
+
+	c = zif_cursor(z);
+	t2 = now();
+	for (size_t j = 0U; j < n; j++) {
+		s2 += zif_utc_time_c(&c, ts[j]);
+	}
+	t2 = now() - t2;
+
+	/* and the batch versions */
+	t3 = now();
+	zif_local_time_v(z, ts, tv, n);
+	t3 = now() - t3;
+
+	t4 = now();
+	zif_utc_time_v(z, ts, tv, n);
+	t4 = now() - t4;
+
+	printf("%-20s\t%s\tlocal %.1fns\tutc %.1fns"
+	       "\tlocal_v %.1fns\tutc_v %.1fns\n",
+	       zn, what,
+	       t1 * 1000000000 / (double)n, t2 * 1000000000 / (double)n,
+	       t3 * 1000000000 / (double)n, t4 * 1000000000 / (double)n);
+	/* keep the compiler from optimising the loops away */
+	sink = s1 ^ s2 ^ tv[n / 2U];
+	zif_close(z);
+	return;
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 0) : 10000000U;
+	stamp_t *ts, *ss, *tv;
+	uint64_t x = 0x2545f4914f6cdd1dULL;
+
+	if ((ts = malloc(3U * n * sizeof(*ts))) == NULL) {
+		return 1;
+	}
+	tv = ts + 2U * n;
+	/* fault the output in now rather than in the first batch run */
+	memset(tv, 0, n * sizeof(*tv));
+	for (size_t i = 0U; i < n; i++) {
+		ts[i] = FROM + (stamp_t)(xrand(&x) % (uint64_t)(TILL - FROM));
+	}
+	/* and the same in order */
+	ss = ts + n;
+	memcpy(ss, ts, n * sizeof(*ts));
+	qsort(ss, n, sizeof(*ss), stamp_cmp);
+
+	for (size_t i = 0U; i < countof(zns); i++) {
+		bench(zns[i], "random", ts, tv, n);
+		bench(zns[i], "sorted", ss, tv, n);
+	}
+	free(ts);
+	return 0;
+}
+
+/* tzraw-bench.c ends here */